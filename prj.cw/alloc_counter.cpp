@@ -0,0 +1,84 @@
+#include "alloc_counter.hpp"
+#include <opencv2/opencv.hpp>
+#include <cstdlib>
+#include <new>
+
+// Инициализация константой, без динамической: счётчик можно трогать из operator new
+// в любой момент жизни потока
+static thread_local size_t t_heap_allocations = 0;
+
+size_t thread_heap_allocations() {
+    return t_heap_allocations;
+}
+
+void* operator new(std::size_t size) {
+    ++t_heap_allocations;
+    if (size == 0) {
+        size = 1;
+    }
+    for (;;) {
+        if (void* p = std::malloc(size)) {
+            return p;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+// Обёртка над аллокатором OpenCV: сам буфер выделяет и освобождает исходный аллокатор
+// (он же остаётся в UMatData::currAllocator), здесь только счёт
+class CountingMatAllocator : public cv::MatAllocator {
+public:
+    explicit CountingMatAllocator(cv::MatAllocator* base) : base_(base) {}
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usage) const override {
+        if (data == nullptr) {
+            ++t_heap_allocations;
+        }
+        return base_->allocate(dims, sizes, type, data, step, flags, usage);
+    }
+
+    bool allocate(cv::UMatData* data, cv::AccessFlag flags, cv::UMatUsageFlags usage) const override {
+        return base_->allocate(data, flags, usage);
+    }
+
+    void deallocate(cv::UMatData* data) const override {
+        base_->deallocate(data);
+    }
+
+private:
+    cv::MatAllocator* base_;
+};
+
+} // namespace
+
+void install_mat_allocation_counter() {
+    static CountingMatAllocator allocator(cv::Mat::getDefaultAllocator());
+    cv::Mat::setDefaultAllocator(&allocator);
+}
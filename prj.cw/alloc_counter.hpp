@@ -0,0 +1,15 @@
+#ifndef ALLOC_COUNTER_HPP
+#define ALLOC_COUNTER_HPP
+
+#include <cstddef>
+
+// Счётчик выделений кучи текущего потока. Считаются вызовы замещённых глобальных operator new
+// и operator new[] (в том числе изнутри OpenCV: std::vector, cv::AutoBuffer, UMatData) и, после
+// install_mat_allocation_counter(), буферы cv::Mat, которые OpenCV берёт через cv::fastMalloc.
+// Не видны только прямые вызовы cv::fastMalloc в обход аллокатора Mat (CvMemStorage и т.п.).
+size_t thread_heap_allocations();
+
+// Ставит аллокатор cv::Mat по умолчанию, считающий выделения буферов; вызывать до запуска потоков.
+void install_mat_allocation_counter();
+
+#endif // ALLOC_COUNTER_HPP
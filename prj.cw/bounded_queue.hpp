@@ -0,0 +1,98 @@
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+// Счётчики очереди между стадиями конвейера.
+// full_waits растёт, когда производитель упирается в заполненную очередь (узкое место ниже по конвейеру),
+// empty_waits - когда потребитель простаивает на пустой (узкое место выше).
+struct QueueStats {
+    size_t capacity = 0;
+    size_t pushed = 0;
+    size_t max_depth = 0;
+    size_t depth_sum = 0;
+    size_t full_waits = 0;
+    size_t empty_waits = 0;
+
+    double mean_depth() const {
+        return pushed > 0 ? static_cast<double>(depth_sum) / pushed : 0.0;
+    }
+};
+
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) {
+        stats_.capacity = capacity > 0 ? capacity : 1;
+    }
+
+    // Блокируется, пока в очереди нет места. Возвращает false, если очередь уже закрыта.
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!closed_ && items_.size() >= stats_.capacity) {
+            ++stats_.full_waits;
+            not_full_.wait(lock, [this] { return closed_ || items_.size() < stats_.capacity; });
+        }
+        if (closed_) {
+            return false;
+        }
+        items_.push_back(std::move(item));
+        ++stats_.pushed;
+        stats_.depth_sum += items_.size();
+        if (items_.size() > stats_.max_depth) {
+            stats_.max_depth = items_.size();
+        }
+        lock.unlock();
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // Блокируется, пока очередь пуста. Возвращает false, когда очередь закрыта и опустела.
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!closed_ && items_.empty()) {
+            ++stats_.empty_waits;
+            not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+        }
+        if (items_.empty()) {
+            return false;
+        }
+        item = std::move(items_.front());
+        items_.pop_front();
+        lock.unlock();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+    size_t depth() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return items_.size();
+    }
+
+    QueueStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<T> items_;
+    QueueStats stats_;
+    bool closed_ = false;
+};
+
+#endif // BOUNDED_QUEUE_HPP
@@ -0,0 +1,33 @@
+#ifndef CLI_ARGS_HPP
+#define CLI_ARGS_HPP
+
+#include <cctype>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+// Целое больше нуля из аргумента командной строки, строка целиком из цифр. false - не число,
+// пробел или знак перед числом, лишние символы после него или значение вне (0, max T];
+// value при этом не меняется.
+template <typename T>
+bool parse_positive(const std::string& text, T& value) {
+    // stoll сам пропускает пробелы и знак, поэтому " 4" и "+4" отсекаются здесь
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) {
+        return false;
+    }
+    long long parsed = 0;
+    size_t used = 0;
+    try {
+        parsed = std::stoll(text, &used);
+    } catch (const std::logic_error&) {
+        return false;
+    }
+    if (used != text.size() || parsed <= 0
+        || static_cast<unsigned long long>(parsed) > static_cast<unsigned long long>(std::numeric_limits<T>::max())) {
+        return false;
+    }
+    value = static_cast<T>(parsed);
+    return true;
+}
+
+#endif // CLI_ARGS_HPP
@@ -0,0 +1,61 @@
+#include "deskew.hpp"
+#include <algorithm>
+#include <cmath>
+
+cv::RotatedRect source_receipt_rect(const PipelineWorkspace& ws, const cv::Size& source_size) {
+    if (ws.resized.empty()) {
+        return cv::RotatedRect();
+    }
+    return scale_rotated_rect(ws.receipt_rect,
+                              static_cast<double>(source_size.width) / ws.resized.cols,
+                              static_cast<double>(source_size.height) / ws.resized.rows);
+}
+
+cv::Mat deskew_crop(const cv::Mat& src, const cv::RotatedRect& rect, int band_rows) {
+    cv::Point2f pts[4];
+    rect.points(pts);
+    cv::Point2f side_a = pts[1] - pts[0];
+    cv::Point2f side_b = pts[2] - pts[1];
+    double len_a = std::hypot(side_a.x, side_a.y);
+    double len_b = std::hypot(side_b.x, side_b.y);
+
+    cv::Point2f long_side = len_a >= len_b ? side_a : side_b;
+    double long_len = std::max(len_a, len_b);
+    double short_len = std::min(len_a, len_b);
+    const int width = static_cast<int>(std::lround(short_len));
+    const int height = static_cast<int>(std::lround(long_len));
+    if (width <= 0 || height <= 0) {
+        return cv::Mat();
+    }
+
+    // v - вниз по результату (вдоль длинной стороны), u - вправо; u = v, повёрнутый на -90 градусов,
+    // чтобы не получить зеркальное отражение
+    double vx = long_side.x / long_len;
+    double vy = long_side.y / long_len;
+    if (vy < 0 || (vy == 0 && vx < 0)) {
+        vx = -vx;
+        vy = -vy;
+    }
+    const double ux = vy;
+    const double uy = -vx;
+
+    // Обратное отображение: точка (x, y) результата -> точка исходного кадра
+    const double ox = rect.center.x - ux * (width - 1) * 0.5 - vx * (height - 1) * 0.5;
+    const double oy = rect.center.y - uy * (width - 1) * 0.5 - vy * (height - 1) * 0.5;
+
+    cv::Mat dst(height, width, src.type());
+    const int band = std::max(1, band_rows);
+    const int bands = (height + band - 1) / band;
+
+    cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range& range) {
+        for (int b = range.start; b < range.end; ++b) {
+            const int y0 = b * band;
+            const int y1 = std::min(height, y0 + band);
+            cv::Matx23d m(ux, vx, ox + vx * y0,
+                          uy, vy, oy + vy * y0);
+            cv::Mat dst_band = dst.rowRange(y0, y1);
+            cv::warpAffine(src, dst_band, m, dst_band.size(), cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_REPLICATE);
+        }
+    });
+    return dst;
+}
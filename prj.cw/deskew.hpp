@@ -0,0 +1,16 @@
+#ifndef DESKEW_HPP
+#define DESKEW_HPP
+
+#include <opencv2/opencv.hpp>
+#include "receipt_pipeline.hpp"
+
+// Прямоугольник чека последнего кадра ws в координатах исходного кадра размера source_size
+cv::RotatedRect source_receipt_rect(const PipelineWorkspace& ws, const cv::Size& source_size);
+
+// Вырезает повёрнутый прямоугольник rect из src в выровненный кадр: длинная сторона чека
+// идёт вертикально, сверху - тот конец, что выше в исходном кадре. Считаются только пиксели
+// результата (warpAffine с обратным отображением), а не весь кадр; полосы по band_rows строк
+// обрабатываются параллельно через cv::parallel_for_.
+cv::Mat deskew_crop(const cv::Mat& src, const cv::RotatedRect& rect, int band_rows = 64);
+
+#endif // DESKEW_HPP
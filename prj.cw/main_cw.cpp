@@ -5,19 +5,35 @@
 #include <cmath>
 #include <filesystem>
 #include <fstream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <sstream>
+#include <chrono>
+#include <array>
+#include <cstdio>
+#include <future>
+#include <csignal>
+#include <cstring>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <poll.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include "alloc_counter.hpp"
+#include "bounded_queue.hpp"
+#include "cli_args.hpp"
+#include "receipt_pipeline.hpp"
+#include "skew_projection.hpp"
+#include "result_cache.hpp"
+#include "deskew.hpp"
 
 namespace fs = std::filesystem;
 
-cv::Mat opencv_resize(const cv::Mat& image, double ratio) {
-    int width = static_cast<int>(image.cols * ratio);
-    int height = static_cast<int>(image.rows * ratio);
-    cv::Size dim(width, height);
-    cv::Mat resized;
-    cv::resize(image, resized, dim, 0, 0, cv::INTER_AREA);
-    return resized;
-}
-
-
 void plot_gray(const cv::Mat& image, const std::string& winname = "Gray Image") {
     cv::imshow(winname, image);
     cv::waitKey(0);
@@ -32,17 +48,6 @@ void plot_rgb(const cv::Mat& image, const std::string& winname = "RGB Image") {
 }
 
 
-cv::Mat dilate_image(const cv::Mat& image, int kernel_size = 9) {
-    cv::Mat dilated;
-    cv::Mat rectKernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(kernel_size, kernel_size));
-    cv::dilate(image, dilated, rectKernel);
-    return dilated;
-}
-
-double pointDist(const cv::Point& a, const cv::Point& b) {
-    return std::sqrt((a.x - b.x)*(a.x - b.x) + (a.y - b.y)*(a.y - b.y));
-}
-
 void draw_normal(cv::Mat& image, const cv::Point& p1, const cv::Point& p2, double length = 30.0, cv::Scalar color = cv::Scalar(0, 0, 255)) {
     cv::Point2f v = p2 - p1;
     cv::Point2f normal(-v.y, v.x);
@@ -65,205 +70,1284 @@ void draw_coordinate_axes(cv::Mat& image, int length = 50) {
 }
 
 
-bool compareContourAreas(const std::vector<cv::Point>& c1, const std::vector<cv::Point>& c2) {
-    return cv::contourArea(c1, false) > cv::contourArea(c2, false);
+double process_image_interactive(const std::string& file_path) {
+    cv::Mat image = cv::imread(file_path);
+    if (image.empty()) {
+        std::cerr << "Ошибка: не удалось загрузить изображение: " << file_path << std::endl;
+        return NOT_FOUND_ANGLE;
+    }
+
+    PipelineWorkspace ws;
+    int largest = run_contour_pipeline(image, ws);
+
+    plot_rgb(ws.resized, "1. Input image");
+    cv::imwrite("resized.jpg", ws.resized);
+
+    plot_gray(ws.gray, "2. Gray");
+    cv::imwrite("gray.jpg", ws.gray);
+
+    plot_gray(ws.blurred, "3. Blurred");
+    cv::imwrite("blurred.jpg", ws.blurred);
+
+    plot_gray(ws.closed, "4. Morfologic");
+    cv::imwrite("Morfologic.jpg", ws.closed);
+
+    plot_gray(ws.dilated, "5. Dilate");
+    cv::imwrite("Dilate.jpg", ws.dilated);
+
+    plot_gray(ws.edged, "6. Edge");
+    cv::imwrite("Edged.jpg", ws.edged);
+
+    if (largest >= 0) {
+        const std::vector<cv::Point>& largest_contour = ws.contours[largest];
+        double angle = calculateCheckAngle(largest_contour, ws.receipt_rect);
+        if (angle > 0) {
+            angle = 90 - angle;
+        }
+        if (angle < 0) {
+            angle = -angle;
+        }
+
+        cv::Mat image_with_largest_contour = ws.resized.clone();
+        cv::drawContours(image_with_largest_contour, ws.contours, largest, cv::Scalar(0, 255, 0), 3);
+        draw_coordinate_axes(image_with_largest_contour);
+
+        cv::RotatedRect minRect = ws.receipt_rect;
+        cv::Point2f rect_points[4];
+        minRect.points(rect_points);
+
+        for (int j = 0; j < 4; j++) {
+            cv::line(image_with_largest_contour, rect_points[j], rect_points[(j + 1) % 4], cv::Scalar(0, 255, 0), 2);
+            draw_normal(image_with_largest_contour, rect_points[j], rect_points[(j + 1) % 4], 30.0, cv::Scalar(0, 0, 255));
+        }
+
+        cv::Point2f center = minRect.center;
+        std::string angle_text = "Angle " + std::to_string(angle).substr(0, 6) + " degr";
+        cv::putText(image_with_largest_contour, angle_text, center, cv::FONT_HERSHEY_SIMPLEX, 0.7, cv::Scalar(255, 0, 255), 2);
+
+        plot_rgb(image_with_largest_contour, "7. With angle");
+        cv::imwrite("With_angle.jpg", image_with_largest_contour);
+
+        // Выровненный чек вырезается из исходного кадра в полном разрешении
+        cv::Mat deskewed = deskew_crop(image, source_receipt_rect(ws, image.size()));
+        if (!deskewed.empty()) {
+            plot_rgb(deskewed, "8. Deskewed");
+            cv::imwrite("Deskewed.jpg", deskewed);
+        }
+
+        return angle;
+    } else {
+        std::cout << "Контуры не найдены в файле: " << file_path << std::endl;
+        return NOT_FOUND_ANGLE;
+    }
 }
 
+struct BatchOptions {
+    std::string res_folder = "/Users/mtrufmanov/MisisProject/misis2025s-22-01-trufmanov-m-a/prj.cw/res";
+    std::string output_file = "/Users/mtrufmanov/MisisProject/misis2025s-22-01-trufmanov-m-a/prj.cw/res.txt";
+    int workers = 0; // 0 - по числу ядер
+    int decode_workers = 2;
+    size_t queue_size = 0; // 0 - два элемента на поток обработки
+    size_t write_batch = 64;
+    bool reduced_decode = false;
+    bool fused_preprocess = false;
+    int close_size = 15;
+    int dilate_size = 9;
+    bool pyramid = false;
+    bool pyramid_fallback = false;
+    std::string socket_path; // режим сервера (--server)
+    // Замеры этапов: сводка p50/p95/p99 в JSON; metrics_per_file - плюс время этапов каждого файла
+    std::string metrics_file;
+    bool metrics_per_file = false;
+    // Инкрементальный режим: индекс уже посчитанных файлов, неизменные файлы не обрабатываются заново
+    std::string index_file;
+    bool drop_page_cache = false; // --drop-cache: однократно прочитанные файлы не держать в page cache
+    // Выровненные и обрезанные чеки (deskew_crop) пишутся сюда под исходными именами
+    std::string deskew_dir;
+    // Несколько чеков на кадре (detect_receipts): в res.txt строка на каждый чек с его рамкой
+    bool multi_receipt = false;
+    bool watch = false; // следить за папкой res_folder и дописывать строки в output_file (--watch)
+    // contour - контуры и minAreaRect, projection - проекционные профили строк (skew_projection),
+    // compare - оба метода: в res.txt угол по контурам и второй столбец, в конце время и расхождение
+    std::string engine = "contour";
+};
+
+int resolve_worker_count(int requested) {
+    if (requested > 0) {
+        return requested;
+    }
+    unsigned int hw = std::thread::hardware_concurrency();
+    return hw > 0 ? static_cast<int>(hw) : 1;
+}
 
-double calculateLineAngle(const cv::Point& p1, const cv::Point& p2) {
-    double dx = p2.x - p1.x;
-    double dy = p2.y - p1.y;
-    return std::atan2(dy, dx) * 180.0 / CV_PI;
+std::vector<fs::path> list_batch_files(const std::string& res_folder) {
+    std::vector<fs::path> files;
+    for (const auto& entry : fs::directory_iterator(res_folder)) {
+        if (entry.is_regular_file()) {
+            files.push_back(entry.path());
+        }
+    }
+    // Порядок directory_iterator не определён, сортируем для детерминированного res.txt
+    std::sort(files.begin(), files.end(), [](const fs::path& a, const fs::path& b) {
+        return a.filename().string() < b.filename().string();
+    });
+    return files;
 }
 
+struct DecodedImage {
+    size_t index = 0;
+    std::string file_path;
+    cv::Mat image;
+    double imread_ms = 0.0;
+    bool cached = false; // угол взят из индекса по хешу содержимого
+    bool cached_found = false;
+    double cached_angle = 0.0;
+};
+
+struct DeskewOutput {
+    std::string file_path;
+    cv::Mat image;
+};
+
+struct BatchResult {
+    size_t index = 0;
+    // Чек не найден - found == false, angle тогда не определён: любое значение, включая -1,
+    // может быть настоящим наклоном
+    bool found = false;
+    double angle = 0.0;
+    double projection_angle = 0.0;
+    bool projection_found = false;
+    double contour_ms = 0.0;
+    double projection_ms = 0.0;
+    StageTimings timings;
+    std::vector<ReceiptDetection> receipts; // --multi
+    bool decoded = false; // кадр удалось прочитать - результат можно класть в индекс
+    bool cached = false;
+};
+
+// Сводка режима --engine compare. Расхождение считается по модулю 180 градусов:
+// контурный метод выдаёт направление длинной стороны, проекционный - только её прямую.
+struct EngineComparison {
+    size_t images = 0;
+    size_t contour_images = 0;
+    size_t projection_images = 0;
+    double contour_ms = 0.0;
+    double projection_ms = 0.0;
+    std::vector<double> differences;
+
+    void add(const BatchResult& result) {
+        const bool contour_found = result.found;
+        ++images;
+        contour_ms += result.contour_ms;
+        projection_ms += result.projection_ms;
+        if (contour_found) {
+            ++contour_images;
+        }
+        if (result.projection_found) {
+            ++projection_images;
+        }
+        if (contour_found && result.projection_found) {
+            differences.push_back(angle_difference_mod180(result.angle, result.projection_angle));
+        }
+    }
 
-double calculateCheckAngle(const std::vector<cv::Point>& contour) {
+    void print() {
+        if (images == 0) {
+            return;
+        }
+        std::cout << "Сравнение методов на " << images << " кадрах:\n";
+        std::cout << "  контуры: угол найден в " << contour_images << ", среднее время " << contour_ms / images << " мс\n";
+        std::cout << "  проекции: угол найден в " << projection_images << ", среднее время " << projection_ms / images << " мс\n";
+        if (differences.empty()) {
+            return;
+        }
+        std::sort(differences.begin(), differences.end());
+        double sum = 0.0;
+        size_t within_2 = 0;
+        for (double d : differences) {
+            sum += d;
+            if (d <= 2.0) {
+                ++within_2;
+            }
+        }
+        std::cout << "  расхождение (по модулю 180): среднее " << sum / differences.size()
+                  << ", медиана " << differences[differences.size() / 2]
+                  << ", максимум " << differences.back()
+                  << ", в пределах 2 градусов " << within_2 << " из " << differences.size() << "\n";
+    }
+};
 
-    cv::RotatedRect minRect = cv::minAreaRect(contour);
+// Угол для res.txt, --watch и ответа сервера: без найденного чека - NOT_FOUND_ANGLE, как всегда было в res.txt
+double output_angle(bool found, double angle) {
+    return found ? angle : NOT_FOUND_ANGLE;
+}
 
+std::string json_escape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        switch (c) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char code[8];
+                    std::snprintf(code, sizeof(code), "\\u%04x", c);
+                    escaped += code;
+                } else {
+                    escaped += c;
+                }
+        }
+    }
+    return escaped;
+}
 
-    cv::Point2f rect_points[4];
-    minRect.points(rect_points);
+// Распределение времени этапов по всем кадрам пакета. Этапы, которые ни разу не выполнялись
+// (например, blur/close/dilate при --fused), в отчёт не попадают.
+struct StageMetrics {
+    std::array<std::vector<double>, STAGE_COUNT> samples;
+    std::vector<std::pair<std::string, StageTimings>> files;
+    bool keep_files = false;
 
+    void add(const std::string& filename, const StageTimings& timings) {
+        for (size_t s = 0; s < STAGE_COUNT; ++s) {
+            samples[s].push_back(timings.ms[s]);
+        }
+        if (keep_files) {
+            files.emplace_back(filename, timings);
+        }
+    }
 
-    double max_length = 0;
-    int longest_side_idx = 0;
+    // Перцентиль по ближайшему рангу, sorted отсортирован по возрастанию
+    static double percentile(const std::vector<double>& sorted, double p) {
+        size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+        return sorted[std::max<size_t>(rank, 1) - 1];
+    }
 
-    for (int i = 0; i < 4; i++) {
-        int j = (i + 1) % 4;
-        double length = pointDist(rect_points[i], rect_points[j]);
-        if (length > max_length) {
-            max_length = length;
-            longest_side_idx = i;
+    bool write_json(const std::string& path) {
+        std::ofstream out(path);
+        if (!out.is_open()) {
+            return false;
+        }
+        out << "{\n  \"images\": " << samples[0].size() << ",\n  \"stages\": {";
+        bool first = true;
+        for (size_t s = 0; s < STAGE_COUNT; ++s) {
+            std::vector<double>& values = samples[s];
+            double total = 0.0;
+            for (double v : values) {
+                total += v;
+            }
+            if (values.empty() || total == 0.0) {
+                continue;
+            }
+            std::sort(values.begin(), values.end());
+            out << (first ? "\n" : ",\n") << "    \"" << stage_name(static_cast<Stage>(s)) << "\": {"
+                << "\"count\": " << values.size()
+                << ", \"total_ms\": " << total
+                << ", \"mean_ms\": " << total / values.size()
+                << ", \"p50_ms\": " << percentile(values, 0.50)
+                << ", \"p95_ms\": " << percentile(values, 0.95)
+                << ", \"p99_ms\": " << percentile(values, 0.99)
+                << ", \"max_ms\": " << values.back() << "}";
+            first = false;
         }
+        out << "\n  }";
+        if (keep_files) {
+            out << ",\n  \"files\": [";
+            for (size_t i = 0; i < files.size(); ++i) {
+                out << (i == 0 ? "\n" : ",\n") << "    {\"file\": \"" << json_escape(files[i].first) << "\"";
+                for (size_t s = 0; s < STAGE_COUNT; ++s) {
+                    out << ", \"" << stage_name(static_cast<Stage>(s)) << "\": " << files[i].second.ms[s];
+                }
+                out << "}";
+            }
+            out << "\n  ]";
+        }
+        out << "\n}\n";
+        return static_cast<bool>(out);
     }
+};
+
+void print_queue_stats(const std::string& name, const QueueStats& stats) {
+    std::cout << "  " << name << ": ёмкость " << stats.capacity
+              << ", макс. глубина " << stats.max_depth
+              << ", средняя глубина " << stats.mean_depth()
+              << ", ожиданий на полной очереди " << stats.full_waits
+              << ", ожиданий на пустой очереди " << stats.empty_waits << "\n";
+}
 
-    cv::Point p1 = rect_points[longest_side_idx];
-    cv::Point p2 = rect_points[(longest_side_idx + 1) % 4];
-    double angle = calculateLineAngle(p1, p2);
+cv::Mat decode_image(const uchar* data, size_t size, bool reduced_decode) {
+    if (reduced_decode) {
+        return decode_reduced_gray(data, size);
+    }
+    if (size == 0) {
+        return cv::Mat();
+    }
+    cv::Mat encoded(1, static_cast<int>(size), CV_8UC1, const_cast<uchar*>(data));
+    return cv::imdecode(encoded, cv::IMREAD_COLOR);
+}
 
-    return angle;
+// Файл декодируется прямо из отображения в память (semcv::MappedFile), без копии в буфер.
+// drop_cache - после декодирования убрать страницы файла из page cache.
+cv::Mat load_image(const std::string& file_path, bool reduced_decode, bool drop_cache = false) {
+    semcv::MappedFile file(file_path);
+    if (!file.is_open()) {
+        return cv::Mat();
+    }
+    cv::Mat image = decode_image(file.data(), file.size(), reduced_decode);
+    file.close(drop_cache);
+    return image;
 }
 
-double process_image_interactive(const std::string& file_path) {
-    cv::Mat image = cv::imread(file_path);
-    if (image.empty()) {
-        std::cerr << "Ошибка: не удалось загрузить изображение: " << file_path << std::endl;
-        return -1.0;
+// Для серверного режима и --watch: файл в этих режимах может дописываться или усекаться прямо
+// во время чтения, а обращение к усечённой части отображения - это SIGBUS и падение всего
+// процесса. Поэтому здесь обычное чтение в буфер (bytes переиспользуется между файлами).
+cv::Mat read_image(const std::string& file_path, bool reduced_decode, std::vector<uchar>& bytes) {
+    if (!read_file_bytes(file_path, bytes)) {
+        return cv::Mat();
     }
+    return decode_image(bytes.data(), bytes.size(), reduced_decode);
+}
+
+void configure_workspace(PipelineWorkspace& ws, const BatchOptions& options) {
+    ws.fused_preprocess = options.fused_preprocess;
+    ws.pyramid = options.pyramid;
+    ws.pyramid_fallback = options.pyramid_fallback;
+    ws.timings.enabled = !options.metrics_file.empty();
+}
+
+// Всё, что влияет на угол. --fused не входит: его результат побитно совпадает с обычным режимом.
+std::string pipeline_version(const BatchOptions& options) {
+    std::ostringstream version;
+    version << PIPELINE_VERSION << "/" << options.engine
+            << "/close" << options.close_size << "/dilate" << options.dilate_size;
+    if (options.reduced_decode) {
+        version << "/reduced";
+    }
+    if (options.pyramid) {
+        version << (options.pyramid_fallback ? "/pyramid+fallback" : "/pyramid");
+    }
+    return version.str();
+}
 
+// Пакетный режим - конвейер из трёх стадий:
+// чтение и декодирование -> поиск чека и угла -> запись res.txt.
+// Стадии связаны ограниченными очередями, поэтому чтение с диска и декодирование
+// идут параллельно с обработкой, а память под декодированные кадры ограничена.
+void process_batch_mode(const BatchOptions& options) {
+    std::ofstream outfile(options.output_file);
+    if (!outfile.is_open()) {
+        std::cerr << "Ошибка: не удалось открыть файл для записи результатов: " << options.output_file << std::endl;
+        return;
+    }
 
-    double resize_ratio = 500.0 / image.rows;
-    cv::Mat resized = opencv_resize(image, resize_ratio);
-    plot_rgb(resized, "1. Input image");
-    cv::imwrite("resized.jpg", resized);
+    std::vector<fs::path> files;
+    try {
+        files = list_batch_files(options.res_folder);
+    } catch (const fs::filesystem_error& e) {
+        std::cerr << "Ошибка: не удалось прочитать папку " << options.res_folder << ": " << e.what() << std::endl;
+        return;
+    }
 
+    const bool use_contour = options.engine != "projection";
+    const bool use_projection = options.engine != "contour";
+    const bool compare = use_contour && use_projection;
 
-    cv::Mat gray;
-    cv::cvtColor(resized, gray, cv::COLOR_BGR2GRAY);
-    plot_gray(gray, "2. Gray");
-    cv::imwrite("gray.jpg", gray);
+    // Инкрементальный режим: файлы с тем же размером и mtime, что в индексе, сразу идут в результат;
+    // остальные читаются, и если совпал хеш содержимого, угол тоже берётся из индекса.
+    const bool incremental = !options.index_file.empty();
+    if (incremental && (compare || options.multi_receipt)) {
+        std::cerr << "Ошибка: --index не совместим с --engine compare и --multi" << std::endl;
+        return;
+    }
+    if (options.multi_receipt && !use_contour) {
+        std::cerr << "Ошибка: --multi работает только с --engine contour" << std::endl;
+        return;
+    }
+    const std::string version = pipeline_version(options);
+    ResultIndex index;
+    std::vector<FileIdentity> identities(files.size());
+    std::map<size_t, BatchResult> reorder;
+    std::vector<size_t> todo;
+    size_t cached_by_mtime = 0;
+    std::atomic<size_t> cached_by_hash(0);
+    if (incremental) {
+        if (!index.load(options.index_file)) {
+            std::cout << "Индекс " << options.index_file << " не найден или не читается, обрабатываются все файлы\n";
+        }
+    }
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (incremental && stat_file_identity(files[i], identities[i])) {
+            const IndexEntry* entry = index.find(files[i].filename().string());
+            if (entry && entry->version == version && entry->identity.size == identities[i].size
+                && entry->identity.mtime == identities[i].mtime) {
+                identities[i].hash = entry->identity.hash;
+                BatchResult cached;
+                cached.index = i;
+                cached.found = entry->found;
+                cached.angle = entry->angle;
+                cached.decoded = true;
+                cached.cached = true;
+                reorder[i] = cached;
+                ++cached_by_mtime;
+                continue;
+            }
+        }
+        todo.push_back(i);
+    }
 
+    const int max_workers = std::max<int>(1, static_cast<int>(todo.size()));
+    const int workers = std::min<int>(resolve_worker_count(options.workers), max_workers);
+    const int decode_workers = std::min<int>(std::max(1, options.decode_workers), max_workers);
+    const size_t queue_size = options.queue_size > 0 ? options.queue_size : static_cast<size_t>(2 * workers);
+    const size_t write_batch = std::max<size_t>(1, options.write_batch);
+
+    // Параллелим по файлам, внутренний пул OpenCV только создавал бы лишние потоки
+    cv::setNumThreads(1);
+
+    BoundedQueue<DecodedImage> decoded_queue(queue_size);
+    BoundedQueue<BatchResult> result_queue(std::max<size_t>(queue_size, write_batch));
+
+    std::atomic<size_t> next_index(0);
+    std::atomic<int> decoders_left(decode_workers);
+    std::atomic<int> detectors_left(workers);
+    std::atomic<size_t> workspace_buffer_growth(0);
+    std::atomic<size_t> workspace_steady_buffer_growth(0);
+    std::atomic<size_t> workspace_heap_allocations(0);
+    std::atomic<size_t> workspace_steady_heap_allocations(0);
+    std::atomic<size_t> pyramid_roi_images(0);
+    std::atomic<size_t> pyramid_fallbacks(0);
+    std::atomic<size_t> pyramid_roi_pixels(0);
+    std::atomic<size_t> pyramid_frame_pixels(0);
+
+    auto decode_stage = [&]() {
+        for (size_t k = next_index++; k < todo.size(); k = next_index++) {
+            const size_t i = todo[k];
+            // Файлы разбираются по порядку каталога: пока этот декодируется, ОС уже читает файл
+            // на decode_workers позиций вперёд - примерно тот, что понадобится этому потоку следующим
+            if (k + decode_workers < todo.size()) {
+                semcv::prefetch_file(files[todo[k + decode_workers]]);
+            }
+            DecodedImage item;
+            item.index = i;
+            item.file_path = files[i].string();
+            try {
+                StageTimings timings;
+                timings.enabled = !options.metrics_file.empty();
+                {
+                    ScopedStage timer(timings, Stage::Imread);
+                    if (!incremental) {
+                        item.image = load_image(item.file_path, options.reduced_decode, options.drop_page_cache);
+                    } else {
+                        semcv::MappedFile file(item.file_path);
+                        if (file.is_open()) {
+                            // Каждый индекс пишет только один поток, писатель читает identities после join()
+                            identities[i].hash = fnv1a_64(file.data(), file.size());
+                            const IndexEntry* entry = index.find(files[i].filename().string());
+                            if (entry && entry->version == version && entry->identity.size == file.size()
+                                && entry->identity.hash == identities[i].hash) {
+                                item.cached = true;
+                                item.cached_found = entry->found;
+                                item.cached_angle = entry->angle;
+                                ++cached_by_hash;
+                            } else {
+                                item.image = decode_image(file.data(), file.size(), options.reduced_decode);
+                            }
+                            file.close(options.drop_page_cache);
+                        }
+                    }
+                }
+                item.imread_ms = timings[Stage::Imread];
+            } catch (const std::exception& e) {
+                std::cerr << "Ошибка при декодировании файла " << item.file_path << ": " << e.what() << std::endl;
+            }
+            if (!decoded_queue.push(std::move(item))) {
+                break;
+            }
+        }
+        if (--decoders_left == 0) {
+            decoded_queue.close();
+        }
+    };
+
+    // Вывод выровненных чеков: warp считается в потоке обработки, запись - отдельным потоком,
+    // чтобы кодирование и диск не задерживали поиск угла на следующих кадрах
+    const bool deskew = !options.deskew_dir.empty();
+    if (deskew) {
+        std::error_code ec;
+        fs::create_directories(options.deskew_dir, ec);
+    }
+    BoundedQueue<DeskewOutput> deskew_queue(queue_size);
+    std::atomic<size_t> warp_images(0);
+    std::atomic<size_t> warp_pixels(0);
+    std::atomic<long long> warp_ns(0);
+    std::atomic<long long> deskew_write_ns(0);
+
+    auto emit_deskewed = [&](const cv::Mat& image, const cv::RotatedRect& rect, const fs::path& name) {
+        auto t0 = std::chrono::steady_clock::now();
+        DeskewOutput output;
+        output.image = deskew_crop(image, rect);
+        warp_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+        if (!output.image.empty()) {
+            ++warp_images;
+            warp_pixels += output.image.total();
+            output.file_path = (fs::path(options.deskew_dir) / name).string();
+            deskew_queue.push(std::move(output));
+        }
+    };
+
+    auto detect_stage = [&]() {
+        PipelineWorkspace ws(options.close_size, options.dilate_size);
+        configure_workspace(ws, options);
+        DecodedImage item;
+        while (decoded_queue.pop(item)) {
+            BatchResult result;
+            result.index = item.index;
+            if (item.cached) {
+                result.found = item.cached_found;
+                result.angle = item.cached_angle;
+                result.decoded = true;
+                result.cached = true;
+            } else if (item.image.empty()) {
+                std::cerr << "Ошибка: не удалось загрузить изображение: " << item.file_path << std::endl;
+            } else {
+                result.decoded = true;
+                try {
+                    if (use_contour) {
+                        auto t0 = std::chrono::steady_clock::now();
+                        if (options.multi_receipt) {
+                            result.receipts = detect_receipts(item.image, ws);
+                            if (!result.receipts.empty()) {
+                                result.angle = result.receipts[0].angle;
+                            }
+                        } else {
+                            result.angle = process_image_batch(item.image, item.file_path, ws);
+                        }
+                        result.found = ws.receipt_found;
+                        result.contour_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+                        if (deskew && ws.receipt_found) {
+                            const fs::path& name = files[item.index].filename();
+                            if (options.multi_receipt) {
+                                // Чек N скана scan.jpg пишется как scan_N.jpg
+                                for (size_t n = 0; n < result.receipts.size(); ++n) {
+                                    fs::path receipt_name = name.stem().string() + "_" + std::to_string(n) + name.extension().string();
+                                    emit_deskewed(item.image, result.receipts[n].rect, receipt_name);
+                                }
+                            } else {
+                                emit_deskewed(item.image, source_receipt_rect(ws, item.image.size()), name);
+                            }
+                        }
+                    }
+                    if (use_projection) {
+                        auto t0 = std::chrono::steady_clock::now();
+                        SkewEstimate estimate = estimate_skew_projection(item.image);
+                        result.projection_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+                        result.projection_found = estimate.found;
+                        result.projection_angle = estimate.angle;
+                        if (!use_contour) {
+                            result.found = estimate.found;
+                            result.angle = estimate.angle;
+                        }
+                    }
+                } catch (const std::exception& e) {
+                    std::cerr << "Ошибка при обработке файла " << item.file_path << ": " << e.what() << std::endl;
+                }
+            }
+            result.timings = ws.timings;
+            result.timings[Stage::Imread] = item.imread_ms;
+            ws.timings.clear();
+            item.image.release();
+            result_queue.push(std::move(result));
+        }
+        workspace_buffer_growth += ws.buffer_growth;
+        workspace_steady_buffer_growth += ws.steady_buffer_growth;
+        workspace_heap_allocations += ws.heap_allocations;
+        workspace_steady_heap_allocations += ws.steady_heap_allocations;
+        pyramid_roi_images += ws.pyramid_roi_images;
+        pyramid_fallbacks += ws.pyramid_fallbacks;
+        pyramid_roi_pixels += ws.pyramid_roi_pixels;
+        pyramid_frame_pixels += ws.pyramid_frame_pixels;
+        if (--detectors_left == 0) {
+            result_queue.close();
+            deskew_queue.close();
+        }
+    };
 
-    cv::Mat blurred;
-    cv::GaussianBlur(gray, blurred, cv::Size(15, 15), 3);
-    plot_gray(blurred, "3. Blurred");
-    cv::imwrite("blurred.jpg", blurred);
+    auto started = std::chrono::steady_clock::now();
 
-    cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(15, 15));
-    cv::morphologyEx(blurred, blurred, cv::MORPH_CLOSE, kernel);
-    plot_gray(blurred, "4. Morfologic");
-    cv::imwrite("Morfologic.jpg", blurred);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < decode_workers; ++t) {
+        threads.emplace_back(decode_stage);
+    }
+    for (int t = 0; t < workers; ++t) {
+        threads.emplace_back(detect_stage);
+    }
+    if (deskew) {
+        threads.emplace_back([&]() {
+            DeskewOutput output;
+            while (deskew_queue.pop(output)) {
+                auto t0 = std::chrono::steady_clock::now();
+                try {
+                    if (!cv::imwrite(output.file_path, output.image)) {
+                        std::cerr << "Ошибка: не удалось записать " << output.file_path << std::endl;
+                    }
+                } catch (const std::exception& e) {
+                    std::cerr << "Ошибка при записи " << output.file_path << ": " << e.what() << std::endl;
+                }
+                deskew_write_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+            }
+        });
+    }
 
-    cv::Mat dilated = dilate_image(blurred, 9);
-    plot_gray(dilated, "5. Dilate");
-    cv::imwrite("Dilate.jpg", dilated);
+    // Стадия записи работает в текущем потоке: результаты приходят в произвольном порядке,
+    // придерживаем их до тех пор, пока не готов следующий по номеру файл, и сбрасываем на диск пачками.
+    std::ostringstream pending;
+    size_t pending_rows = 0;
+    size_t next_to_write = 0;
+    EngineComparison comparison;
+    StageMetrics metrics;
+    metrics.keep_files = options.metrics_per_file;
+
+    if (options.multi_receipt) {
+        outfile << "Filename,Receipt,Angle (degrees),X,Y,Width,Height\n";
+    } else {
+        outfile << (compare ? "Filename,Angle (degrees),Projection angle (degrees)\n" : "Filename,Angle (degrees)\n");
+    }
 
+    std::vector<double> angles(files.size(), 0.0);
+    std::vector<char> found(files.size(), 0);
+    std::vector<char> decoded(files.size(), 0);
+
+    auto write_ready = [&]() {
+        for (auto it = reorder.begin(); it != reorder.end() && it->first == next_to_write; it = reorder.erase(it)) {
+            const std::string filename = files[next_to_write].filename().string();
+            const BatchResult& row = it->second;
+            angles[next_to_write] = row.angle;
+            found[next_to_write] = row.found;
+            decoded[next_to_write] = row.decoded;
+            if (options.multi_receipt) {
+                // По строке на чек; кадр без чеков - одна строка с номером -1
+                for (size_t n = 0; n < row.receipts.size(); ++n) {
+                    const ReceiptDetection& receipt = row.receipts[n];
+                    pending << filename << "," << n << "," << receipt.angle << "," << receipt.bbox.x << "," << receipt.bbox.y
+                            << "," << receipt.bbox.width << "," << receipt.bbox.height << "\n";
+                }
+                if (row.receipts.empty()) {
+                    pending << filename << ",-1," << NOT_FOUND_ANGLE << ",0,0,0,0\n";
+                }
+            } else {
+                pending << filename << "," << output_angle(row.found, row.angle);
+                if (compare) {
+                    pending << "," << output_angle(row.projection_found, row.projection_angle);
+                    comparison.add(row);
+                }
+                pending << "\n";
+            }
+            if (!row.cached) {
+                if (!options.metrics_file.empty()) {
+                    metrics.add(filename, row.timings);
+                }
+                std::cout << "Обработан файл: " << filename << " - ";
+                if (row.found) {
+                    std::cout << "угол: " << row.angle << " градусов";
+                } else {
+                    std::cout << "чек не найден";
+                }
+                if (options.multi_receipt) {
+                    std::cout << ", чеков: " << row.receipts.size();
+                }
+                std::cout << "\n";
+            }
+            ++next_to_write;
+            if (++pending_rows >= write_batch) {
+                outfile << pending.str();
+                outfile.flush();
+                pending.str("");
+                pending_rows = 0;
+            }
+        }
+    };
+
+    // Взятые из индекса по mtime результаты уже лежат в reorder
+    write_ready();
+    BatchResult result;
+    while (result_queue.pop(result)) {
+        const size_t index = result.index;
+        reorder[index] = std::move(result);
+        write_ready();
+    }
+    outfile << pending.str();
 
-    cv::Mat edged;
-    cv::Canny(dilated, edged, 50, 125, 3);
-    plot_gray(edged, "6. Edge");
-    cv::imwrite("Edged.jpg", edged);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    outfile.close();
 
-    std::vector<std::vector<cv::Point>> contours;
-    std::vector<cv::Vec4i> hierarchy;
-    cv::findContours(edged, contours, hierarchy, cv::RETR_TREE, cv::CHAIN_APPROX_SIMPLE);
+    if (incremental) {
+        // Новый индекс - ровно текущее содержимое папки: удалённые файлы из него выпадают
+        ResultIndex updated;
+        for (size_t i = 0; i < files.size(); ++i) {
+            if (decoded[i] && identities[i].hash != 0) {
+                IndexEntry entry;
+                entry.identity = identities[i];
+                entry.version = version;
+                entry.found = found[i];
+                entry.angle = angles[i];
+                updated.put(files[i].filename().string(), entry);
+            }
+        }
+        if (!updated.save(options.index_file)) {
+            std::cerr << "Ошибка: не удалось сохранить индекс " << options.index_file << std::endl;
+        }
+    }
 
-    if (!contours.empty()) {
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "Обработка завершена: " << files.size() << " файлов за " << seconds << " с ("
+              << decode_workers << " потоков декодирования, " << workers << " потоков обработки).\n";
+    if (incremental) {
+        std::cout << "Из индекса: " << cached_by_mtime << " файлов по размеру и mtime, " << cached_by_hash
+                  << " по хешу содержимого; обработано заново: " << todo.size() - cached_by_hash << "\n";
+    }
+    std::cout << "Очереди конвейера:\n";
+    print_queue_stats("декодирование -> обработка", decoded_queue.stats());
+    print_queue_stats("обработка -> запись", result_queue.stats());
+    if (compare) {
+        comparison.print();
+    }
+    if (deskew) {
+        double warp_seconds = warp_ns * 1e-9;
+        std::cout << "Выравнивание: " << warp_images << " чеков, " << warp_pixels / 1e6 << " Мпикс за "
+                  << warp_seconds * 1000.0 << " мс warp";
+        if (warp_seconds > 0) {
+            std::cout << " (" << warp_pixels / 1e6 / warp_seconds << " Мпикс/с на поток)";
+        }
+        std::cout << ", запись " << deskew_write_ns * 1e-6 << " мс; файлы в " << options.deskew_dir << "\n";
+    }
+    if (!options.metrics_file.empty()) {
+        if (metrics.write_json(options.metrics_file)) {
+            std::cout << "Время этапов сохранено в: " << options.metrics_file << "\n";
+        } else {
+            std::cerr << "Ошибка: не удалось записать метрики в " << options.metrics_file << std::endl;
+        }
+    }
+    if (options.pyramid) {
+        std::cout << "Пирамида: ROI найден в " << pyramid_roi_images << " кадрах";
+        if (pyramid_frame_pixels > 0) {
+            std::cout << ", средняя доля кадра " << 100.0 * pyramid_roi_pixels / pyramid_frame_pixels << "%";
+        }
+        std::cout << ", повторов по всему кадру " << pyramid_fallbacks << "\n";
+    }
+    // Только буферы рабочих пространств: выделения внутри OpenCV, декодирования и записи сюда не входят
+    std::cout << "Рост буферов рабочих пространств: всего " << workspace_buffer_growth
+              << ", после первого кадра " << workspace_steady_buffer_growth << "\n";
+    // Все выделения кучи на потоке поиска угла за время конвейера, включая внутренние буферы OpenCV
+    std::cout << "Выделения кучи в конвейере: всего " << workspace_heap_allocations
+              << ", после первого кадра на каждом потоке " << workspace_steady_heap_allocations << "\n";
+    std::cout << "Результаты сохранены в: " << options.output_file << std::endl;
+}
 
-        std::sort(contours.begin(), contours.end(), compareContourAreas);
 
+// Долгоживущие режимы (--server, --watch) останавливаются по SIGINT/SIGTERM: обработчик только
+// ставит флаг, а циклы ждут событий через poll с таймаутом и проверяют его.
+volatile std::sig_atomic_t stop_requested = 0;
 
-        std::vector<cv::Point> largest_contour = contours[0];
+void request_stop(int) {
+    stop_requested = 1;
+}
 
-        double angle = calculateCheckAngle(largest_contour);
-        if (angle > 0) {
-            angle = 90 - angle;
+// Ждёт данных на fd, проверяя флаг остановки раз в 500 мс; false - остановка или ошибка poll
+bool wait_readable(int fd) {
+    while (!stop_requested) {
+        pollfd pfd{fd, POLLIN, 0};
+        int ready = ::poll(&pfd, 1, 500);
+        if (ready > 0) {
+            return true;
         }
-        if (angle < 0) {
-            angle = -angle;
+        if (ready < 0 && errno != EINTR) {
+            return false;
         }
+    }
+    return false;
+}
 
-        cv::Mat image_with_largest_contour = resized.clone();
-        std::vector<std::vector<cv::Point>> draw_contours = {largest_contour};
-        cv::drawContours(image_with_largest_contour, draw_contours, -1, cv::Scalar(0, 255, 0), 3);
-        draw_coordinate_axes(image_with_largest_contour);
+// Режим сервера: процесс живёт долго, OpenCV инициализируется один раз, а кадры приходят
+// через Unix-сокет. Протокол построчный, на одном соединении можно слать запросы подряд:
+//   PATH <путь к файлу>\n
+//   DATA <число байт>\n<закодированное изображение>
+//   QUIT\n
+// На каждый запрос - одна строка ответа:
+//   OK <угол> queue_ms=<..> decode_ms=<..> detect_ms=<..> total_ms=<..>\n (угол -1 - чек не найден, как в res.txt)
+//   ERR <описание>\n
+// Соединения обслуживает постоянный пул потоков (server_connection_threads), принятые сверх него
+// ждут в ограниченной очереди, а дальше - в очереди listen ядра. Потоки соединений только читают
+// и пишут сокет, декодирование и поиск угла идут в общем пуле из --workers потоков, у каждого
+// своё рабочее пространство.
+const size_t MAX_REQUEST_BYTES = 64 * 1024 * 1024;
+
+struct ServerReply {
+    bool ok = false;
+    std::string error;
+    bool found = false;
+    double angle = 0.0;
+    double queue_ms = 0.0;
+    double decode_ms = 0.0;
+    double detect_ms = 0.0;
+};
+
+struct ServerJob {
+    std::string file_path; // пустой - кадр в bytes
+    std::vector<uchar> bytes;
+    std::chrono::steady_clock::time_point submitted;
+    std::promise<ServerReply> reply;
+};
+
+class SocketReader {
+public:
+    explicit SocketReader(int fd) : fd_(fd) {}
+
+    bool read_line(std::string& line) {
+        size_t pos;
+        while ((pos = buffer_.find('\n')) == std::string::npos) {
+            if (buffer_.size() > 16384 || !fill()) {
+                return false;
+            }
+        }
+        line = buffer_.substr(0, pos);
+        buffer_.erase(0, pos + 1);
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        return true;
+    }
 
-        cv::RotatedRect minRect = cv::minAreaRect(largest_contour);
-        cv::Point2f rect_points[4];
-        minRect.points(rect_points);
+    bool read_bytes(size_t count, std::vector<uchar>& bytes) {
+        bytes.resize(count);
+        size_t taken = std::min(count, buffer_.size());
+        std::memcpy(bytes.data(), buffer_.data(), taken);
+        buffer_.erase(0, taken);
+        while (taken < count) {
+            if (!wait_readable(fd_)) {
+                return false;
+            }
+            ssize_t n = ::read(fd_, bytes.data() + taken, count - taken);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            taken += static_cast<size_t>(n);
+        }
+        return true;
+    }
 
-        for (int j = 0; j < 4; j++) {
-            cv::line(image_with_largest_contour, rect_points[j], rect_points[(j + 1) % 4], cv::Scalar(0, 255, 0), 2);
-            draw_normal(image_with_largest_contour, rect_points[j], rect_points[(j + 1) % 4], 30.0, cv::Scalar(0, 0, 255));
+private:
+    bool fill() {
+        char chunk[4096];
+        for (;;) {
+            if (!wait_readable(fd_)) {
+                return false;
+            }
+            ssize_t n = ::read(fd_, chunk, sizeof(chunk));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            buffer_.append(chunk, static_cast<size_t>(n));
+            return true;
         }
+    }
 
-        cv::Point2f center = minRect.center;
-        std::string angle_text = "Angle " + std::to_string(angle).substr(0, 6) + " degr";
-        cv::putText(image_with_largest_contour, angle_text, center, cv::FONT_HERSHEY_SIMPLEX, 0.7, cv::Scalar(255, 0, 255), 2);
+    int fd_;
+    std::string buffer_;
+};
 
-        plot_rgb(image_with_largest_contour, "7. With angle");
-        cv::imwrite("With_angle.jpg", image_with_largest_contour);
+bool write_all(int fd, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        written += static_cast<size_t>(n);
+    }
+    return true;
+}
 
-        return angle;
-    } else {
-        std::cout << "Контуры не найдены в файле: " << file_path << std::endl;
-        return -1.0;
+std::string format_reply(const ServerReply& reply, double total_ms) {
+    std::ostringstream out;
+    if (!reply.ok) {
+        out << "ERR " << reply.error << "\n";
+        return out.str();
     }
+    out << "OK " << output_angle(reply.found, reply.angle) << " queue_ms=" << reply.queue_ms
+        << " decode_ms=" << reply.decode_ms
+        << " detect_ms=" << reply.detect_ms
+        << " total_ms=" << total_ms << "\n";
+    return out.str();
 }
 
-double process_image_batch(const std::string& file_path) {
-    cv::Mat image = cv::imread(file_path);
+ServerReply run_server_job(ServerJob& job, PipelineWorkspace& ws, const BatchOptions& options) {
+    using clock = std::chrono::steady_clock;
+    ServerReply reply;
+    auto started = clock::now();
+    reply.queue_ms = std::chrono::duration<double, std::milli>(started - job.submitted).count();
+
+    const std::string name = job.file_path.empty() ? "<socket>" : job.file_path;
+    cv::Mat image;
+    try {
+        image = job.file_path.empty() ? decode_image(job.bytes.data(), job.bytes.size(), options.reduced_decode)
+                                      : read_image(job.file_path, options.reduced_decode, job.bytes);
+    } catch (const std::exception& e) {
+        reply.error = std::string("decode failed: ") + e.what();
+        return reply;
+    }
+    job.bytes.clear();
+    job.bytes.shrink_to_fit();
+    auto decoded = clock::now();
+    reply.decode_ms = std::chrono::duration<double, std::milli>(decoded - started).count();
     if (image.empty()) {
-        std::cerr << "Ошибка: не удалось загрузить изображение: " << file_path << std::endl;
-        return -1.0;
+        reply.error = "cannot decode image";
+        return reply;
     }
 
-    double resize_ratio = 500.0 / image.rows;
-    cv::Mat resized = opencv_resize(image, resize_ratio);
+    try {
+        if (options.engine == "projection") {
+            SkewEstimate estimate = estimate_skew_projection(image);
+            reply.found = estimate.found;
+            reply.angle = estimate.angle;
+        } else {
+            reply.angle = process_image_batch(image, name, ws);
+            reply.found = ws.receipt_found;
+        }
+    } catch (const std::exception& e) {
+        reply.error = std::string("processing failed: ") + e.what();
+        return reply;
+    }
+    reply.detect_ms = std::chrono::duration<double, std::milli>(clock::now() - decoded).count();
+    reply.ok = true;
+    return reply;
+}
 
+void serve_connection(int fd, BoundedQueue<ServerJob>& jobs) {
+    SocketReader reader(fd);
+    std::string line;
+    while (reader.read_line(line)) {
+        auto started = std::chrono::steady_clock::now();
+        ServerJob job;
+        std::string reply_text;
+        if (line == "QUIT") {
+            break;
+        } else if (line.compare(0, 5, "PATH ") == 0 && line.size() > 5) {
+            job.file_path = line.substr(5);
+        } else if (line.compare(0, 5, "DATA ") == 0) {
+            size_t count = 0;
+            try {
+                count = static_cast<size_t>(std::stoull(line.substr(5)));
+            } catch (const std::exception&) {
+                count = 0;
+            }
+            if (count == 0 || count > MAX_REQUEST_BYTES) {
+                // Тело запроса не прочитать - дальше поток не синхронизирован, закрываем соединение
+                write_all(fd, "ERR bad DATA size\n");
+                break;
+            }
+            if (!reader.read_bytes(count, job.bytes)) {
+                break;
+            }
+        } else {
+            reply_text = "ERR unknown request\n";
+        }
 
-    cv::Mat gray;
-    cv::cvtColor(resized, gray, cv::COLOR_BGR2GRAY);
+        if (reply_text.empty()) {
+            job.submitted = started;
+            std::future<ServerReply> reply = job.reply.get_future();
+            if (!jobs.push(std::move(job))) {
+                break;
+            }
+            ServerReply result = reply.get();
+            double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+            reply_text = format_reply(result, total_ms);
+        }
+        if (!write_all(fd, reply_text)) {
+            break;
+        }
+    }
+    ::close(fd);
+}
 
-    cv::Mat blurred;
-    cv::GaussianBlur(gray, blurred, cv::Size(15, 15), 3);
+int server_connection_threads(int workers) {
+    return std::max(4, 2 * workers);
+}
 
-    cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(15, 15));
-    cv::morphologyEx(blurred, blurred, cv::MORPH_CLOSE, kernel);
+// Работает до SIGINT/SIGTERM: тогда перестаёт принимать соединения, закрывает открытые (начатый
+// запрос успевает получить ответ), дожидается пула и удаляет файл сокета. Файл сокета от прошлого
+// запуска удаляется при старте.
+int process_server_mode(const BatchOptions& options) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (options.socket_path.empty() || options.socket_path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Ошибка: недопустимый путь сокета: " << options.socket_path << std::endl;
+        return 1;
+    }
+    std::strncpy(addr.sun_path, options.socket_path.c_str(), sizeof(addr.sun_path) - 1);
 
-    cv::Mat dilated = dilate_image(blurred, 9);
+    // Клиент может закрыть соединение до ответа - это не повод завершать сервер
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, request_stop);
+    std::signal(SIGTERM, request_stop);
 
-    cv::Mat edged;
-    cv::Canny(dilated, edged, 50, 125, 3);
+    int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        std::cerr << "Ошибка: socket(): " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    ::unlink(options.socket_path.c_str());
+    if (::bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(listen_fd, SOMAXCONN) < 0) {
+        std::cerr << "Ошибка: не удалось слушать сокет " << options.socket_path << ": " << std::strerror(errno) << std::endl;
+        ::close(listen_fd);
+        return 1;
+    }
 
-    std::vector<std::vector<cv::Point>> contours;
-    std::vector<cv::Vec4i> hierarchy;
-    cv::findContours(edged, contours, hierarchy, cv::RETR_TREE, cv::CHAIN_APPROX_SIMPLE);
+    const int workers = resolve_worker_count(options.workers);
+    const size_t queue_size = options.queue_size > 0 ? options.queue_size : static_cast<size_t>(2 * workers);
+    cv::setNumThreads(1);
+
+    BoundedQueue<ServerJob> jobs(queue_size);
+    std::vector<std::thread> pool;
+    for (int t = 0; t < workers; ++t) {
+        pool.emplace_back([&]() {
+            PipelineWorkspace ws(options.close_size, options.dilate_size);
+            configure_workspace(ws, options);
+            ServerJob job;
+            while (jobs.pop(job)) {
+                job.reply.set_value(run_server_job(job, ws, options));
+            }
+        });
+    }
 
-    if (!contours.empty()) {
-        std::sort(contours.begin(), contours.end(), compareContourAreas);
+    const int connection_threads = server_connection_threads(workers);
+    BoundedQueue<int> connections(static_cast<size_t>(connection_threads));
+    std::vector<std::thread> connection_pool;
+    for (int t = 0; t < connection_threads; ++t) {
+        connection_pool.emplace_back([&]() {
+            int fd = -1;
+            while (connections.pop(fd)) {
+                serve_connection(fd, jobs);
+            }
+        });
+    }
 
-        std::vector<cv::Point> largest_contour = contours[0];
+    std::cout << "Сервер слушает " << options.socket_path << " (" << workers << " потоков обработки, "
+              << connection_threads << " потоков соединений), Ctrl+C - выход" << std::endl;
+    while (wait_readable(listen_fd)) {
+        int fd = ::accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            std::cerr << "Ошибка: accept(): " << std::strerror(errno) << std::endl;
+            // Например, кончились дескрипторы - даём открытым соединениям закрыться
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+        // Все потоки соединений заняты - ждём здесь, новые клиенты копятся в очереди listen
+        connections.push(fd);
+    }
 
-        double angle = calculateCheckAngle(largest_contour);
-        return angle;
-    } else {
-        std::cout << "Контуры не найдены в файле: " << file_path << std::endl;
-        return -1.0;
+    // Соединения из очереди потоки ещё заберут и сразу закроют: флаг остановки уже стоит
+    ::close(listen_fd);
+    ::unlink(options.socket_path.c_str());
+    connections.close();
+    for (auto& thread : connection_pool) {
+        thread.join();
     }
+    jobs.close();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    std::cout << "Сервер остановлен" << std::endl;
+    return 0;
 }
 
-void process_batch_mode() {
-    std::string res_folder = "/Users/mtrufmanov/MisisProject/misis2025s-22-01-trufmanov-m-a/prj.cw/res";
-    std::string output_file = "/Users/mtrufmanov/MisisProject/misis2025s-22-01-trufmanov-m-a/prj.cw/res.txt";
+// Режим наблюдения: новые файлы в res_folder (закрытые после записи или переименованные в неё)
+// сразу уходят в пул обработки, а строки дописываются в output_file в порядке готовности.
+// Задержка считается от получения события inotify до записи строки; сводка - при Ctrl+C / SIGTERM.
 
-    std::ofstream outfile(output_file);
-    if (!outfile.is_open()) {
-        std::cerr << "Ошибка: не удалось открыть файл для записи результатов: " << output_file << std::endl;
+struct WatchJob {
+    std::string file_path;
+    std::chrono::steady_clock::time_point event_time;
+};
+
+struct WatchResult {
+    std::string filename;
+    bool found = false;
+    double angle = 0.0;
+    std::chrono::steady_clock::time_point event_time;
+};
+
+void print_latency_summary(std::vector<double>& latencies_ms) {
+    if (latencies_ms.empty()) {
+        std::cout << "Новых файлов не было.\n";
         return;
     }
+    std::sort(latencies_ms.begin(), latencies_ms.end());
+    double sum = 0.0;
+    for (double v : latencies_ms) {
+        sum += v;
+    }
+    std::cout << "Обработано файлов: " << latencies_ms.size()
+              << "; задержка от закрытия файла до строки в res.txt, мс: среднее " << sum / latencies_ms.size()
+              << ", p50 " << StageMetrics::percentile(latencies_ms, 0.50)
+              << ", p95 " << StageMetrics::percentile(latencies_ms, 0.95)
+              << ", p99 " << StageMetrics::percentile(latencies_ms, 0.99)
+              << ", макс. " << latencies_ms.back() << "\n";
+}
 
-    outfile << "Filename,Angle (degrees)" << std::endl;
+#ifdef __linux__
+int process_watch_mode(const BatchOptions& options) {
+    int inotify_fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (inotify_fd < 0) {
+        std::cerr << "Ошибка: inotify_init1(): " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    if (inotify_add_watch(inotify_fd, options.res_folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        std::cerr << "Ошибка: не удалось следить за папкой " << options.res_folder << ": " << std::strerror(errno) << std::endl;
+        ::close(inotify_fd);
+        return 1;
+    }
 
-    for (const auto& entry : fs::directory_iterator(res_folder)) {
-        if (entry.is_regular_file()) {
-            std::string file_path = entry.path().string();
-            std::string filename = entry.path().filename().string();
+    const bool write_header = !fs::exists(options.output_file) || fs::file_size(options.output_file) == 0;
+    std::ofstream outfile(options.output_file, std::ios::app);
+    if (!outfile.is_open()) {
+        std::cerr << "Ошибка: не удалось открыть файл для записи результатов: " << options.output_file << std::endl;
+        ::close(inotify_fd);
+        return 1;
+    }
+    if (write_header) {
+        outfile << "Filename,Angle (degrees)\n";
+        outfile.flush();
+    }
 
+    std::signal(SIGINT, request_stop);
+    std::signal(SIGTERM, request_stop);
+
+    const int workers = resolve_worker_count(options.workers);
+    const size_t queue_size = options.queue_size > 0 ? options.queue_size : static_cast<size_t>(2 * workers);
+    cv::setNumThreads(1);
+
+    BoundedQueue<WatchJob> jobs(queue_size);
+    BoundedQueue<WatchResult> results(queue_size);
+    std::atomic<int> workers_left(workers);
+
+    std::vector<std::thread> pool;
+    for (int t = 0; t < workers; ++t) {
+        pool.emplace_back([&]() {
+            PipelineWorkspace ws(options.close_size, options.dilate_size);
+            configure_workspace(ws, options);
+            WatchJob job;
+            std::vector<uchar> bytes;
+            while (jobs.pop(job)) {
+                WatchResult result;
+                result.filename = fs::path(job.file_path).filename().string();
+                result.event_time = job.event_time;
+                try {
+                    cv::Mat image = read_image(job.file_path, options.reduced_decode, bytes);
+                    if (image.empty()) {
+                        std::cerr << "Ошибка: не удалось загрузить изображение: " << job.file_path << std::endl;
+                    } else if (options.engine == "projection") {
+                        SkewEstimate estimate = estimate_skew_projection(image);
+                        result.found = estimate.found;
+                        result.angle = estimate.angle;
+                    } else {
+                        result.angle = process_image_batch(image, job.file_path, ws);
+                        result.found = ws.receipt_found;
+                    }
+                } catch (const std::exception& e) {
+                    std::cerr << "Ошибка при обработке файла " << job.file_path << ": " << e.what() << std::endl;
+                }
+                results.push(std::move(result));
+            }
+            if (--workers_left == 0) {
+                results.close();
+            }
+        });
+    }
 
-            double angle = process_image_batch(file_path);
+    // Каждая строка сбрасывается на диск сразу - ради неё режим и нужен
+    std::vector<double> latencies_ms;
+    std::thread writer([&]() {
+        WatchResult result;
+        while (results.pop(result)) {
+            outfile << result.filename << "," << output_angle(result.found, result.angle) << "\n";
+            outfile.flush();
+            double latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - result.event_time).count();
+            latencies_ms.push_back(latency);
+            std::cout << "Обработан файл: " << result.filename << " - ";
+            if (result.found) {
+                std::cout << "угол: " << result.angle << " градусов";
+            } else {
+                std::cout << "чек не найден";
+            }
+            std::cout << ", задержка " << latency << " мс\n";
+        }
+    });
 
+    std::cout << "Слежу за папкой " << options.res_folder << " (" << workers << " потоков обработки), Ctrl+C - выход" << std::endl;
 
-            outfile << filename << "," << angle << std::endl;
-            std::cout << "Обработан файл: " << filename << " - угол: " << angle << " градусов" << std::endl;
+    alignas(inotify_event) char buffer[64 * 1024];
+    while (!stop_requested) {
+        pollfd pfd{inotify_fd, POLLIN, 0};
+        int ready = ::poll(&pfd, 1, 500);
+        if (ready <= 0) {
+            continue; // таймаут или EINTR - заодно проверяем флаг остановки
+        }
+        ssize_t length = ::read(inotify_fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            continue;
+        }
+        auto event_time = std::chrono::steady_clock::now();
+        for (ssize_t offset = 0; offset < length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            if (event->mask & IN_Q_OVERFLOW) {
+                std::cerr << "Предупреждение: очередь inotify переполнена, часть файлов пропущена" << std::endl;
+                continue;
+            }
+            // Скрытые файлы - обычно временные, под которыми сканер пишет файл перед переименованием
+            if ((event->mask & IN_ISDIR) || event->len == 0 || event->name[0] == '.') {
+                continue;
+            }
+            WatchJob job;
+            job.file_path = (fs::path(options.res_folder) / event->name).string();
+            job.event_time = event_time;
+            jobs.push(std::move(job));
         }
     }
 
-    outfile.close();
-    std::cout << "Обработка завершена. Результаты сохранены в: " << output_file << std::endl;
-}
+    jobs.close();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    writer.join();
+    ::close(inotify_fd);
 
+    print_latency_summary(latencies_ms);
+    std::cout << "Результаты дописаны в: " << options.output_file << std::endl;
+    return 0;
+}
+#else
+int process_watch_mode(const BatchOptions&) {
+    std::cerr << "Ошибка: режим --watch использует inotify и доступен только в Linux" << std::endl;
+    return 1;
+}
+#endif
 
 
 void process_interactive_mode() {
@@ -275,7 +1359,94 @@ void process_interactive_mode() {
     std::cout << "Вычисленный угол поворота чека: " << angle << " градусов" << std::endl;
 }
 
-int main() {
+void print_usage(const char* prog) {
+    std::cout << "Использование: " << prog << " [--batch] [--input <папка>] [--output <res.txt>] [--workers <N>]\n"
+              << "    [--decode-workers <N>] [--queue-size <N>] [--write-batch <N>] [--reduced-decode] [--fused]\n"
+              << "    [--close-size <N>] [--dilate-size <N>] [--engine contour|projection|compare]\n"
+              << "    [--pyramid] [--pyramid-fallback] [--metrics <metrics.json>] [--metrics-per-file]\n"
+              << "    [--index <файл индекса>] [--drop-cache] [--deskew-dir <папка>] [--multi]\n";
+    std::cout << "       " << prog << " --watch [--input <папка>] [--output <res.txt>] [параметры обработки]\n";
+    std::cout << "       " << prog << " --server <сокет> [те же параметры обработки]\n";
+    std::cout << "Без --batch режим выбирается интерактивно.\n";
+}
+
+int main(int argc, char** argv) {
+    install_mat_allocation_counter();
+    BatchOptions batch_options;
+    bool batch_requested = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        // Числовые параметры - целые больше нуля; иначе, как и для неизвестного ключа, справка и код 1
+        bool valid = true;
+        if (arg == "--batch") {
+            batch_requested = true;
+        } else if (arg == "--input" && i + 1 < argc) {
+            batch_options.res_folder = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            batch_options.output_file = argv[++i];
+        } else if (arg == "--workers" && i + 1 < argc) {
+            valid = parse_positive(argv[++i], batch_options.workers);
+        } else if (arg == "--decode-workers" && i + 1 < argc) {
+            valid = parse_positive(argv[++i], batch_options.decode_workers);
+        } else if (arg == "--queue-size" && i + 1 < argc) {
+            valid = parse_positive(argv[++i], batch_options.queue_size);
+        } else if (arg == "--write-batch" && i + 1 < argc) {
+            valid = parse_positive(argv[++i], batch_options.write_batch);
+        } else if (arg == "--reduced-decode") {
+            batch_options.reduced_decode = true;
+        } else if (arg == "--fused") {
+            batch_options.fused_preprocess = true;
+        } else if (arg == "--close-size" && i + 1 < argc) {
+            valid = parse_positive(argv[++i], batch_options.close_size);
+        } else if (arg == "--dilate-size" && i + 1 < argc) {
+            valid = parse_positive(argv[++i], batch_options.dilate_size);
+        } else if (arg == "--server" && i + 1 < argc) {
+            batch_options.socket_path = argv[++i];
+        } else if (arg == "--metrics" && i + 1 < argc) {
+            batch_options.metrics_file = argv[++i];
+        } else if (arg == "--metrics-per-file") {
+            batch_options.metrics_per_file = true;
+        } else if (arg == "--drop-cache") {
+            batch_options.drop_page_cache = true;
+        } else if (arg == "--deskew-dir" && i + 1 < argc) {
+            batch_options.deskew_dir = argv[++i];
+        } else if (arg == "--multi") {
+            batch_options.multi_receipt = true;
+        } else if (arg == "--watch") {
+            batch_options.watch = true;
+        } else if (arg == "--index" && i + 1 < argc) {
+            batch_options.index_file = argv[++i];
+        } else if (arg == "--pyramid") {
+            batch_options.pyramid = true;
+        } else if (arg == "--pyramid-fallback") {
+            batch_options.pyramid = true;
+            batch_options.pyramid_fallback = true;
+        } else if (arg == "--engine" && i + 1 < argc) {
+            batch_options.engine = argv[++i];
+            valid = batch_options.engine == "contour" || batch_options.engine == "projection" || batch_options.engine == "compare";
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (batch_options.watch) {
+        return process_watch_mode(batch_options);
+    }
+
+    if (!batch_options.socket_path.empty()) {
+        return process_server_mode(batch_options);
+    }
+
+    if (batch_requested) {
+        process_batch_mode(batch_options);
+        return 0;
+    }
+
     int mode = 0;
     std::cout << "Выберите режим работы:\n";
     std::cout << "1 - Интерактивный режим (обработка одного изображения с отображением этапов)\n";
@@ -287,7 +1458,7 @@ int main() {
     if (mode == 1) {
         process_interactive_mode();
     } else if (mode == 2) {
-        process_batch_mode();
+        process_batch_mode(batch_options);
     } else {
         std::cerr << "Ошибка: неверный режим. Допустимые значения: 1 или 2" << std::endl;
         return 1;
@@ -0,0 +1,615 @@
+#include "receipt_pipeline.hpp"
+#include "alloc_counter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+
+cv::Size opencv_resize_size(const cv::Size& size, double ratio) {
+    int width = static_cast<int>(size.width * ratio);
+    int height = static_cast<int>(size.height * ratio);
+    return cv::Size(width, height);
+}
+
+double pointDist(const cv::Point& a, const cv::Point& b) {
+    return std::sqrt((a.x - b.x)*(a.x - b.x) + (a.y - b.y)*(a.y - b.y));
+}
+
+// Верхняя оценка площади многоугольника за один проход по точкам, без корней:
+// не больше площади рамки и не больше P^2 / (4*pi) (изопериметрическое неравенство), где вместо
+// евклидова периметра берётся L1-периметр - он не меньше евклидова, так что оценка остаётся верной.
+static double contour_area_bound(const std::vector<cv::Point>& contour) {
+    if (contour.size() < 3) {
+        return 0.0;
+    }
+    int min_x = contour[0].x, max_x = contour[0].x;
+    int min_y = contour[0].y, max_y = contour[0].y;
+    long long perimeter = 0;
+    cv::Point prev = contour.back();
+    for (const cv::Point& p : contour) {
+        min_x = std::min(min_x, p.x);
+        max_x = std::max(max_x, p.x);
+        min_y = std::min(min_y, p.y);
+        max_y = std::max(max_y, p.y);
+        perimeter += std::abs(p.x - prev.x) + std::abs(p.y - prev.y);
+        prev = p;
+    }
+    double box = static_cast<double>(max_x - min_x) * (max_y - min_y);
+    double isoperimetric = static_cast<double>(perimeter) * perimeter / (4.0 * CV_PI);
+    return std::min(box, isoperimetric);
+}
+
+ContourSelector::ContourSelector(size_t keep) : keep_(std::max<size_t>(keep, 1)) {
+}
+
+int ContourSelector::select(const std::vector<std::vector<cv::Point>>& contours) {
+    indices_.clear();
+    areas_.clear();
+    evaluated_ = 0;
+    pruned_ = 0;
+
+    for (size_t i = 0; i < contours.size(); ++i) {
+        const bool full = indices_.size() >= keep_;
+        double bound = contour_area_bound(contours[i]);
+        if (bound < min_area || (full && bound <= areas_.back())) {
+            ++pruned_;
+            continue;
+        }
+        ++evaluated_;
+        double area = cv::contourArea(contours[i], false);
+        if (area < min_area || (full && area <= areas_.back())) {
+            continue;
+        }
+        // При равной площади выигрывает контур с меньшим индексом
+        size_t pos = std::upper_bound(areas_.begin(), areas_.end(), area, std::greater<double>()) - areas_.begin();
+        areas_.insert(areas_.begin() + pos, area);
+        indices_.insert(indices_.begin() + pos, static_cast<int>(i));
+        if (indices_.size() > keep_) {
+            areas_.pop_back();
+            indices_.pop_back();
+        }
+    }
+    return indices_.empty() ? -1 : indices_.front();
+}
+
+
+double calculateLineAngle(const cv::Point& p1, const cv::Point& p2) {
+    double dx = p2.x - p1.x;
+    double dy = p2.y - p1.y;
+    return std::atan2(dy, dx) * 180.0 / CV_PI;
+}
+
+
+double calculateCheckAngle(const std::vector<cv::Point>& contour) {
+    cv::RotatedRect minRect;
+    return calculateCheckAngle(contour, minRect);
+}
+
+double calculateCheckAngle(const std::vector<cv::Point>& contour, cv::RotatedRect& minRect) {
+
+    minRect = cv::minAreaRect(contour);
+
+
+    cv::Point2f rect_points[4];
+    minRect.points(rect_points);
+
+
+    double max_length = 0;
+    int longest_side_idx = 0;
+
+    for (int i = 0; i < 4; i++) {
+        int j = (i + 1) % 4;
+        double length = pointDist(rect_points[i], rect_points[j]);
+        if (length > max_length) {
+            max_length = length;
+            longest_side_idx = i;
+        }
+    }
+
+    cv::Point p1 = rect_points[longest_side_idx];
+    cv::Point p2 = rect_points[(longest_side_idx + 1) % 4];
+    double angle = calculateLineAngle(p1, p2);
+
+    return angle;
+}
+
+cv::RotatedRect scale_rotated_rect(const cv::RotatedRect& rect, double sx, double sy) {
+    // Масштабы по осям отличаются только на округление размеров при resize, так что размер
+    // масштабируем средним - прямоугольник остаётся прямоугольником
+    const double s = 0.5 * (sx + sy);
+    return cv::RotatedRect(cv::Point2f(static_cast<float>(rect.center.x * sx), static_cast<float>(rect.center.y * sy)),
+                           cv::Size2f(static_cast<float>(rect.size.width * s), static_cast<float>(rect.size.height * s)),
+                           rect.angle);
+}
+
+static int read_u16(const uchar* p, bool little_endian) {
+    return little_endian ? (p[0] | (p[1] << 8)) : ((p[0] << 8) | p[1]);
+}
+
+static uint32_t read_u32(const uchar* p, bool little_endian) {
+    return little_endian
+        ? (uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24))
+        : ((uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]));
+}
+
+static int read_exif_orientation(const uchar* tiff, size_t size) {
+    if (size < 8) {
+        return 1;
+    }
+    bool le = tiff[0] == 'I' && tiff[1] == 'I';
+    if (!le && !(tiff[0] == 'M' && tiff[1] == 'M')) {
+        return 1;
+    }
+    uint32_t ifd = read_u32(tiff + 4, le);
+    if (ifd + 2 > size) {
+        return 1;
+    }
+    int entries = read_u16(tiff + ifd, le);
+    for (int i = 0; i < entries; ++i) {
+        size_t entry = ifd + 2 + static_cast<size_t>(i) * 12;
+        if (entry + 12 > size) {
+            break;
+        }
+        if (read_u16(tiff + entry, le) == 0x0112) {
+            int orientation = read_u16(tiff + entry + 8, le);
+            return (orientation >= 1 && orientation <= 8) ? orientation : 1;
+        }
+    }
+    return 1;
+}
+
+// Разбирает маркеры JPEG до начала скана: размеры кадра из SOF и ориентацию из EXIF.
+bool read_jpeg_header(const uchar* data, size_t size, JpegHeaderInfo& info) {
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+        return false;
+    }
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) {
+            return false;
+        }
+        int marker = data[pos + 1];
+        if (marker == 0xFF) {
+            ++pos;
+            continue;
+        }
+        if (marker == 0xD8 || (marker >= 0xD0 && marker <= 0xD7) || marker == 0x01) {
+            pos += 2;
+            continue;
+        }
+        if (marker == 0xDA || marker == 0xD9) {
+            break;
+        }
+        size_t length = static_cast<size_t>(read_u16(data + pos + 2, false));
+        const uchar* payload = data + pos + 4;
+        if (length < 2 || pos + 2 + length > size) {
+            return false;
+        }
+        bool is_sof = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (is_sof && length >= 7) {
+            info.height = read_u16(payload + 1, false);
+            info.width = read_u16(payload + 3, false);
+        } else if (marker == 0xE1 && length >= 8 && std::memcmp(payload, "Exif\0\0", 6) == 0) {
+            info.orientation = read_exif_orientation(payload + 6, length - 8);
+        }
+        pos += 2 + length;
+    }
+    return info.width > 0 && info.height > 0;
+}
+
+// Выбирает наибольший масштаб DCT (1/8, 1/4, 1/2), при котором в кадре после поворота по EXIF
+// остаётся не меньше target_rows строк.
+int choose_reduced_decode_flag(const JpegHeaderInfo& info, int target_rows) {
+    bool transposed = info.orientation >= 5;
+    int rows = transposed ? info.width : info.height;
+    if ((rows + 7) / 8 >= target_rows) {
+        return cv::IMREAD_REDUCED_GRAYSCALE_8;
+    }
+    if ((rows + 3) / 4 >= target_rows) {
+        return cv::IMREAD_REDUCED_GRAYSCALE_4;
+    }
+    if ((rows + 1) / 2 >= target_rows) {
+        return cv::IMREAD_REDUCED_GRAYSCALE_2;
+    }
+    return cv::IMREAD_GRAYSCALE;
+}
+
+bool read_file_bytes(const std::string& file_path, std::vector<uchar>& bytes) {
+    std::ifstream file(file_path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::streamsize size = file.tellg();
+    if (size <= 0) {
+        return false;
+    }
+    bytes.resize(static_cast<size_t>(size));
+    file.seekg(0);
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(bytes.data()), size));
+}
+
+// Быстрый путь декодирования: JPEG сразу в оттенки серого с уменьшением в libjpeg,
+// так что до target_rows дожимает уже только cv::resize на небольшом кадре.
+// Для не-JPEG файлов декодирует в полном размере.
+cv::Mat decode_reduced_gray(const uchar* data, size_t size, int target_rows) {
+    if (size == 0) {
+        return cv::Mat();
+    }
+    JpegHeaderInfo info;
+    int flag = cv::IMREAD_GRAYSCALE;
+    if (read_jpeg_header(data, size, info)) {
+        flag = choose_reduced_decode_flag(info, target_rows);
+    }
+    cv::Mat encoded(1, static_cast<int>(size), CV_8UC1, const_cast<uchar*>(data));
+    return cv::imdecode(encoded, flag);
+}
+
+
+
+cv::Mat& WorkspaceBuffer::reserve(int rows, int cols, int type, size_t& growth) {
+    size_t bytes = static_cast<size_t>(rows) * static_cast<size_t>(cols) * CV_ELEM_SIZE(type);
+    if (bytes > storage_.size()) {
+        header_.release();
+        storage_.resize(bytes);
+        ++growth;
+    }
+    if (header_.data != storage_.data() || header_.rows != rows || header_.cols != cols || header_.type() != type) {
+        header_ = cv::Mat(rows, cols, type, storage_.data());
+    }
+    return header_;
+}
+
+bool WorkspaceBuffer::owns(const cv::Mat& mat) const {
+    return !storage_.empty() && mat.data == storage_.data();
+}
+
+PipelineWorkspace::PipelineWorkspace(int close_size, int dilate_size)
+    : close_size(close_size), dilate_size(dilate_size) {
+}
+
+static void check_owned(const WorkspaceBuffer& buffer, const cv::Mat& mat, size_t& growth) {
+    if (!buffer.owns(mat)) {
+        ++growth;
+    }
+}
+
+// Сколько строк у внутреннего края полосы портят close (dilate + erode) и dilate
+int fused_halo_rows(const PipelineWorkspace& ws) {
+    return 2 * (ws.close_size / 2) + ws.dilate_size / 2;
+}
+
+int fused_strip_rows(int cols) {
+    // Три полосы (blur, промежуточная и итоговая close) должны помещаться в половину типичного L2 (512 КБ).
+    // Запас считаем для ядер по умолчанию (15 и 9).
+    const size_t l2_budget = 256 * 1024;
+    const int default_halo = 7 + 7 + 4;
+    int rows_fit = static_cast<int>(l2_budget / (3 * static_cast<size_t>(std::max(cols, 1))));
+    return std::max(16, rows_fit - 2 * default_halo);
+}
+
+// Точность на стыках полос:
+// - GaussianBlur считается по ROI серого кадра, а для ROI OpenCV берёт соседние строки
+//   из родительской матрицы, поэтому размытая полоса точна целиком, включая запас;
+// - close и dilate считаются на отдельной полосе, и у её внутренних краёв неверными
+//   оказываются 7 (dilate) + 7 (erode) + 4 (dilate 9x9) строк - ровно fused_halo_rows();
+// - у настоящих краёв кадра полоса начинается/заканчивается там же, где и кадр,
+//   и граница обрабатывается так же, как при обработке кадра целиком.
+void fused_blur_close_dilate(const cv::Mat& gray, cv::Mat& dst, PipelineWorkspace& ws) {
+    const int rows = gray.rows;
+    const int cols = gray.cols;
+    const int halo = fused_halo_rows(ws);
+    const int strip = ws.strip_rows > 0 ? ws.strip_rows : fused_strip_rows(cols);
+    const int max_rows = std::min(rows, strip + 2 * halo);
+    const cv::Size close_ksize(ws.close_size, ws.close_size);
+    const cv::Size dilate_ksize(ws.dilate_size, ws.dilate_size);
+
+    // Резервируем полный размер полосы заранее, чтобы хранилище не росло на второй полосе
+    ws.strip_blurred_buffer.reserve(max_rows, cols, gray.type(), ws.buffer_growth);
+    ws.strip_tmp_buffer.reserve(max_rows, cols, gray.type(), ws.buffer_growth);
+    ws.strip_closed_buffer.reserve(max_rows, cols, gray.type(), ws.buffer_growth);
+
+    for (int y0 = 0; y0 < rows; y0 += strip) {
+        const int y1 = std::min(rows, y0 + strip);
+        const int a = std::max(0, y0 - halo);
+        const int b = std::min(rows, y1 + halo);
+
+        // Заголовки именно b - a строк, а не ROI большего буфера: иначе морфология
+        // заглянула бы в устаревшие строки за концом полосы.
+        cv::Mat blurred = ws.strip_blurred_buffer.reserve(b - a, cols, gray.type(), ws.buffer_growth);
+        cv::GaussianBlur(gray.rowRange(a, b), blurred, cv::Size(15, 15), 3);
+        check_owned(ws.strip_blurred_buffer, blurred, ws.buffer_growth);
+
+        cv::Mat tmp = ws.strip_tmp_buffer.reserve(b - a, cols, gray.type(), ws.buffer_growth);
+        cv::Mat closed = ws.strip_closed_buffer.reserve(b - a, cols, gray.type(), ws.buffer_growth);
+        semcv::dilate_rect(blurred, tmp, close_ksize);
+        semcv::erode_rect(tmp, closed, close_ksize);
+        check_owned(ws.strip_closed_buffer, closed, ws.buffer_growth);
+
+        // semcv, как и cv::dilate, берёт соседей ROI из родительской полосы
+        cv::Mat dst_rows = dst.rowRange(y0, y1);
+        semcv::dilate_rect(closed.rowRange(y0 - a, y1 - a), dst_rows, dilate_ksize);
+    }
+}
+
+static int odd_kernel(int size, double scale) {
+    return std::max(3, static_cast<int>(std::lround(size * scale)) | 1);
+}
+
+// resize до dim -> gray; ws.resized и ws.gray - кадр целиком
+static void resize_to_gray(const cv::Mat& image, const cv::Size& dim, PipelineWorkspace& ws) {
+    ws.resized = ws.resized_buffer.reserve(dim.height, dim.width, image.type(), ws.buffer_growth);
+    {
+        ScopedStage timer(ws.timings, Stage::Resize);
+        cv::resize(image, ws.resized, dim, 0, 0, cv::INTER_AREA);
+    }
+    check_owned(ws.resized_buffer, ws.resized, ws.buffer_growth);
+
+    if (ws.resized.channels() == 1) {
+        ws.gray = ws.resized;
+    } else {
+        ws.gray = ws.gray_buffer.reserve(dim.height, dim.width, CV_8UC1, ws.buffer_growth);
+        ScopedStage timer(ws.timings, Stage::CvtColor);
+        cv::cvtColor(ws.resized, ws.gray, cv::COLOR_BGR2GRAY);
+        check_owned(ws.gray_buffer, ws.gray, ws.buffer_growth);
+    }
+}
+
+// GaussianBlur -> close -> dilate -> Canny -> findContours над gray (это может быть ROI кадра).
+// scale - масштаб относительно TARGET_ROWS, под него пересчитываются ядра;
+// offset сдвигает контуры в координаты кадра.
+static void run_contour_chain(const cv::Mat& gray, double scale, const cv::Point& offset, PipelineWorkspace& ws) {
+    const int rows = gray.rows;
+    const int cols = gray.cols;
+
+    ws.dilated = ws.dilated_buffer.reserve(rows, cols, gray.type(), ws.buffer_growth);
+    if (ws.fused_preprocess && scale == 1.0) {
+        ScopedStage timer(ws.timings, Stage::FusedPreprocess);
+        fused_blur_close_dilate(gray, ws.dilated, ws);
+    } else {
+        const int blur_size = odd_kernel(15, scale);
+        const int close_size = scale == 1.0 ? ws.close_size : odd_kernel(ws.close_size, scale);
+        const int dilate_size = scale == 1.0 ? ws.dilate_size : odd_kernel(ws.dilate_size, scale);
+
+        ws.blurred = ws.blurred_buffer.reserve(rows, cols, gray.type(), ws.buffer_growth);
+        {
+            ScopedStage timer(ws.timings, Stage::GaussianBlur);
+            cv::GaussianBlur(gray, ws.blurred, cv::Size(blur_size, blur_size), 3 * scale);
+        }
+        check_owned(ws.blurred_buffer, ws.blurred, ws.buffer_growth);
+
+        // MORPH_CLOSE = dilate, затем erode тем же прямоугольником
+        cv::Mat close_tmp = ws.close_tmp_buffer.reserve(rows, cols, gray.type(), ws.buffer_growth);
+        ws.closed = ws.closed_buffer.reserve(rows, cols, gray.type(), ws.buffer_growth);
+        {
+            ScopedStage timer(ws.timings, Stage::Morphology);
+            semcv::dilate_rect(ws.blurred, close_tmp, cv::Size(close_size, close_size));
+            semcv::erode_rect(close_tmp, ws.closed, cv::Size(close_size, close_size));
+        }
+        check_owned(ws.closed_buffer, ws.closed, ws.buffer_growth);
+
+        ScopedStage timer(ws.timings, Stage::Dilate);
+        semcv::dilate_rect(ws.closed, ws.dilated, cv::Size(dilate_size, dilate_size));
+    }
+    check_owned(ws.dilated_buffer, ws.dilated, ws.buffer_growth);
+
+    ws.edged = ws.edged_buffer.reserve(rows, cols, CV_8UC1, ws.buffer_growth);
+    {
+        ScopedStage timer(ws.timings, Stage::Canny);
+        cv::Canny(ws.dilated, ws.edged, 50, 125, 3);
+    }
+    check_owned(ws.edged_buffer, ws.edged, ws.buffer_growth);
+
+    ScopedStage timer(ws.timings, Stage::FindContours);
+    cv::findContours(ws.edged, ws.contours, ws.hierarchy, ws.contour_mode, cv::CHAIN_APPROX_SIMPLE, offset);
+}
+
+static void finish_image(PipelineWorkspace& ws, size_t growth_before, size_t contours_capacity, size_t hierarchy_capacity) {
+    if (ws.contours.capacity() != contours_capacity || ws.hierarchy.capacity() != hierarchy_capacity) {
+        ++ws.buffer_growth;
+    }
+    if (ws.images > 0) {
+        ws.steady_buffer_growth += ws.buffer_growth - growth_before;
+    }
+    ++ws.images;
+}
+
+// Цепочка без выбора контура: detect_receipts отбирает кандидатов своим селектором
+static void run_contour_stages(const cv::Mat& image, PipelineWorkspace& ws) {
+    const size_t growth_before = ws.buffer_growth;
+    const size_t contours_capacity = ws.contours.capacity();
+    const size_t hierarchy_capacity = ws.hierarchy.capacity();
+
+    double resize_ratio = static_cast<double>(TARGET_ROWS) / image.rows;
+    cv::Size dim = opencv_resize_size(image.size(), resize_ratio);
+
+    resize_to_gray(image, dim, ws);
+    run_contour_chain(ws.gray, 1.0, cv::Point(), ws);
+
+    finish_image(ws, growth_before, contours_capacity, hierarchy_capacity);
+}
+
+int run_contour_pipeline(const cv::Mat& image, PipelineWorkspace& ws) {
+    run_contour_stages(image, ws);
+
+    ScopedStage timer(ws.timings, Stage::SelectContour);
+    return ws.selector.select(ws.contours);
+}
+
+// Кадр уменьшается до TARGET_ROWS один раз; грубый уровень пирамиды (PYRAMID_COARSE_ROWS) строится
+// уже из него. Полная цепочка затем идёт по ROI того же кадра: фильтры OpenCV и semcv берут соседей
+// ROI из родительского кадра, так что внутри ROI (с запасом на ядра) результат совпадает с полным кадром.
+int run_pyramid_pipeline(const cv::Mat& image, PipelineWorkspace& ws) {
+    const size_t growth_before = ws.buffer_growth;
+    const size_t contours_capacity = ws.contours.capacity();
+    const size_t hierarchy_capacity = ws.hierarchy.capacity();
+
+    double resize_ratio = static_cast<double>(TARGET_ROWS) / image.rows;
+    cv::Size dim = opencv_resize_size(image.size(), resize_ratio);
+    resize_to_gray(image, dim, ws);
+
+    const double scale = static_cast<double>(PYRAMID_COARSE_ROWS) / TARGET_ROWS;
+    cv::Size coarse_dim = opencv_resize_size(dim, scale);
+    ws.coarse_gray = ws.coarse_gray_buffer.reserve(coarse_dim.height, coarse_dim.width, CV_8UC1, ws.buffer_growth);
+    {
+        ScopedStage timer(ws.timings, Stage::Resize);
+        cv::resize(ws.gray, ws.coarse_gray, coarse_dim, 0, 0, cv::INTER_AREA);
+    }
+    check_owned(ws.coarse_gray_buffer, ws.coarse_gray, ws.buffer_growth);
+
+    run_contour_chain(ws.coarse_gray, scale, cv::Point(), ws);
+
+    ws.roi = cv::Rect();
+    ws.coarse_angle = -1.0;
+    int largest = -1;
+    {
+        ScopedStage timer(ws.timings, Stage::SelectContour);
+        largest = ws.selector.select(ws.contours);
+    }
+    if (largest >= 0) {
+        {
+            ScopedStage timer(ws.timings, Stage::MinAreaRect);
+            ws.coarse_angle = calculateCheckAngle(ws.contours[largest]);
+        }
+
+        // Рамка грубого контура в координатах TARGET_ROWS с запасом на ядра и на неточность грубого уровня
+        cv::Rect box = cv::boundingRect(ws.contours[largest]);
+        const double up = static_cast<double>(dim.height) / coarse_dim.height;
+        const int margin = std::max(fused_halo_rows(ws) + 8, dim.height / 20);
+        int x0 = static_cast<int>(std::floor(box.x * up)) - margin;
+        int y0 = static_cast<int>(std::floor(box.y * up)) - margin;
+        int x1 = static_cast<int>(std::ceil((box.x + box.width) * up)) + margin;
+        int y1 = static_cast<int>(std::ceil((box.y + box.height) * up)) + margin;
+        ws.roi = cv::Rect(cv::Point(x0, y0), cv::Point(x1, y1)) & cv::Rect(0, 0, dim.width, dim.height);
+    }
+
+    if (!ws.roi.empty()) {
+        run_contour_chain(ws.gray(ws.roi), 1.0, ws.roi.tl(), ws);
+        ++ws.pyramid_roi_images;
+        ws.pyramid_roi_pixels += static_cast<size_t>(ws.roi.area());
+        ws.pyramid_frame_pixels += static_cast<size_t>(dim.area());
+    }
+    if (ws.contours.empty() && ws.pyramid_fallback) {
+        ++ws.pyramid_fallbacks;
+        run_contour_chain(ws.gray, 1.0, cv::Point(), ws);
+    }
+
+    finish_image(ws, growth_before, contours_capacity, hierarchy_capacity);
+
+    ScopedStage timer(ws.timings, Stage::SelectContour);
+    return ws.selector.select(ws.contours);
+}
+
+static void count_heap_allocations(PipelineWorkspace& ws, size_t images_before, size_t allocations_before) {
+    const size_t allocations = thread_heap_allocations() - allocations_before;
+    ws.heap_allocations += allocations;
+    if (images_before > 0) {
+        ws.steady_heap_allocations += allocations;
+    }
+}
+
+static std::vector<ReceiptDetection> find_receipts(const cv::Mat& image, PipelineWorkspace& ws, const MultiReceiptOptions& options) {
+    std::vector<ReceiptDetection> receipts;
+    ws.timings.clear();
+    ws.receipt_found = false;
+
+    run_contour_stages(image, ws);
+    if (ws.contours.empty()) {
+        return receipts;
+    }
+
+    ContourSelector selector(options.max_candidates);
+    selector.min_area = options.min_area_fraction * ws.resized.rows * ws.resized.cols;
+    {
+        ScopedStage timer(ws.timings, Stage::SelectContour);
+        selector.select(ws.contours);
+    }
+    const std::vector<int>& candidates = selector.indices();
+    const std::vector<double>& areas = selector.areas();
+    const double sx = static_cast<double>(image.cols) / ws.resized.cols;
+    const double sy = static_cast<double>(image.rows) / ws.resized.rows;
+    const cv::Rect frame(0, 0, image.cols, image.rows);
+
+    {
+        ScopedStage timer(ws.timings, Stage::MinAreaRect);
+        for (size_t c = 0; c < candidates.size() && receipts.size() < options.max_receipts; ++c) {
+            const std::vector<cv::Point>& contour = ws.contours[candidates[c]];
+            cv::RotatedRect rect;
+            double angle = calculateCheckAngle(contour, rect);
+            double long_side = std::max(rect.size.width, rect.size.height);
+            double short_side = std::min(rect.size.width, rect.size.height);
+            if (short_side <= 0.0) {
+                continue;
+            }
+            // Чек на скане - почти прямоугольник: контур заполняет свой minAreaRect и не слишком вытянут
+            if (areas[c] / (long_side * short_side) < options.min_rectangularity || long_side / short_side > options.max_aspect) {
+                continue;
+            }
+            cv::Rect box = cv::boundingRect(contour);
+            int x0 = static_cast<int>(std::floor(box.x * sx));
+            int y0 = static_cast<int>(std::floor(box.y * sy));
+            int x1 = static_cast<int>(std::ceil((box.x + box.width) * sx));
+            int y1 = static_cast<int>(std::ceil((box.y + box.height) * sy));
+
+            ReceiptDetection receipt;
+            receipt.angle = angle;
+            receipt.area = areas[c];
+            receipt.rect = scale_rotated_rect(rect, sx, sy);
+            receipt.bbox = cv::Rect(cv::Point(x0, y0), cv::Point(x1, y1)) & frame;
+            receipts.push_back(receipt);
+        }
+    }
+
+    // Нумерация чеков - по положению на скане: сверху вниз, затем слева направо
+    std::sort(receipts.begin(), receipts.end(), [](const ReceiptDetection& a, const ReceiptDetection& b) {
+        return a.bbox.y != b.bbox.y ? a.bbox.y < b.bbox.y : a.bbox.x < b.bbox.x;
+    });
+    if (!receipts.empty()) {
+        ws.receipt_found = true;
+    }
+    return receipts;
+}
+
+std::vector<ReceiptDetection> detect_receipts(const cv::Mat& image, PipelineWorkspace& ws, const MultiReceiptOptions& options) {
+    const size_t images_before = ws.images;
+    const size_t allocations_before = thread_heap_allocations();
+    std::vector<ReceiptDetection> receipts = find_receipts(image, ws, options);
+    count_heap_allocations(ws, images_before, allocations_before);
+    return receipts;
+}
+
+// image - цветной кадр (как из cv::imread) либо уже серый кадр из decode_reduced_gray.
+double process_image_batch(const cv::Mat& image, const std::string& file_path, PipelineWorkspace& ws) {
+    const size_t images_before = ws.images;
+    const size_t allocations_before = thread_heap_allocations();
+    ws.timings.clear();
+    ws.receipt_found = false;
+    int largest = ws.pyramid ? run_pyramid_pipeline(image, ws) : run_contour_pipeline(image, ws);
+    double angle = NOT_FOUND_ANGLE;
+    if (largest >= 0) {
+        ScopedStage timer(ws.timings, Stage::MinAreaRect);
+        ws.receipt_found = true;
+        angle = calculateCheckAngle(ws.contours[largest], ws.receipt_rect);
+    }
+    count_heap_allocations(ws, images_before, allocations_before);
+    if (!ws.receipt_found) {
+        std::cout << "Контуры не найдены в файле: " << file_path << std::endl;
+    }
+    return angle;
+}
+
+double process_image_batch(const cv::Mat& image, const std::string& file_path) {
+    thread_local PipelineWorkspace ws;
+    return process_image_batch(image, file_path, ws);
+}
+
+double process_image_batch(const std::string& file_path) {
+    cv::Mat image = cv::imread(file_path);
+    if (image.empty()) {
+        std::cerr << "Ошибка: не удалось загрузить изображение: " << file_path << std::endl;
+        return NOT_FOUND_ANGLE;
+    }
+    return process_image_batch(image, file_path);
+}
+
@@ -0,0 +1,207 @@
+#ifndef RECEIPT_PIPELINE_HPP
+#define RECEIPT_PIPELINE_HPP
+
+#include <opencv2/opencv.hpp>
+#include "semcv.hpp"
+#include "stage_timer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+const int TARGET_ROWS = 500;
+const int PYRAMID_COARSE_ROWS = 125;
+// Версия алгоритма поиска угла для индекса инкрементальных запусков.
+// Увеличивать при любом изменении, которое может поменять углы.
+const int PIPELINE_VERSION = 2;
+// Угол "чек не найден" во всех текстовых выводах (res.txt, ответ сервера, --watch, CSV evaluate_cw)
+// и в возврате process_image_batch. Решения внутри программ принимаются по флагам found
+// (PipelineWorkspace::receipt_found, SkewEstimate::found): оценка проекциями может дать и
+// настоящие -1 градус, которые в тексте от "не найден" не отличить.
+const double NOT_FOUND_ANGLE = -1.0;
+
+cv::Size opencv_resize_size(const cv::Size& size, double ratio);
+
+double pointDist(const cv::Point& a, const cv::Point& b);
+double calculateLineAngle(const cv::Point& p1, const cv::Point& p2);
+double calculateCheckAngle(const std::vector<cv::Point>& contour);
+double calculateCheckAngle(const std::vector<cv::Point>& contour, cv::RotatedRect& min_rect);
+
+struct JpegHeaderInfo {
+    int width = 0;
+    int height = 0;
+    int orientation = 1; // EXIF Orientation, 1 - без поворота
+};
+
+bool read_jpeg_header(const uchar* data, size_t size, JpegHeaderInfo& info);
+int choose_reduced_decode_flag(const JpegHeaderInfo& info, int target_rows);
+bool read_file_bytes(const std::string& file_path, std::vector<uchar>& bytes);
+cv::Mat decode_reduced_gray(const uchar* data, size_t size, int target_rows = TARGET_ROWS);
+
+// Отбор наибольших по площади контуров за один проход. Площадь каждого контура считается
+// не больше одного раза, а контуры, чья верхняя оценка площади (по рамке и периметру) не больше
+// keep-го лучшего или меньше min_area, отбрасываются вовсе без contourArea.
+class ContourSelector {
+public:
+    explicit ContourSelector(size_t keep = 1);
+
+    // Индекс наибольшего контура или -1
+    int select(const std::vector<std::vector<cv::Point>>& contours);
+
+    // Лучшие контуры по убыванию площади, не больше keep
+    const std::vector<int>& indices() const {
+        return indices_;
+    }
+    const std::vector<double>& areas() const {
+        return areas_;
+    }
+    size_t evaluated() const {
+        return evaluated_;
+    }
+    size_t pruned() const {
+        return pruned_;
+    }
+
+    double min_area = 0.0;
+
+private:
+    size_t keep_;
+    std::vector<int> indices_;
+    std::vector<double> areas_;
+    size_t evaluated_ = 0;
+    size_t pruned_ = 0;
+};
+
+// Переводит прямоугольник из уменьшенного кадра (TARGET_ROWS строк) в координаты исходного кадра
+cv::RotatedRect scale_rotated_rect(const cv::RotatedRect& rect, double sx, double sy);
+
+// Буфер изображения с собственным хранилищем: заголовок rows x cols строится поверх
+// уже выделенной памяти, хранилище растёт только если не хватает ёмкости.
+class WorkspaceBuffer {
+public:
+    cv::Mat& reserve(int rows, int cols, int type, size_t& growth);
+    // false, если OpenCV заменил данные заголовка своей памятью (и, значит, выделил её)
+    bool owns(const cv::Mat& mat) const;
+
+private:
+    std::vector<uchar> storage_;
+    cv::Mat header_;
+};
+
+// Рабочее пространство конвейера поиска чека: промежуточные изображения, размеры ядер морфологии
+// и контуры переиспользуются от кадра к кадру. Один экземпляр на поток.
+struct PipelineWorkspace {
+    explicit PipelineWorkspace(int close_size = 15, int dilate_size = 9);
+
+    WorkspaceBuffer resized_buffer;
+    WorkspaceBuffer gray_buffer;
+    WorkspaceBuffer blurred_buffer;
+    WorkspaceBuffer close_tmp_buffer;
+    WorkspaceBuffer closed_buffer;
+    WorkspaceBuffer dilated_buffer;
+    WorkspaceBuffer edged_buffer;
+
+    cv::Mat resized;
+    cv::Mat gray;
+    cv::Mat blurred;
+    cv::Mat closed;
+    cv::Mat dilated;
+    cv::Mat edged;
+
+    // Прямоугольные ядра close и dilate. Морфология идёт через semcv::erode_rect/dilate_rect,
+    // время которых не зависит от размера ядра, так что их можно увеличивать для шумных сканов.
+    int close_size;
+    int dilate_size;
+
+    // Слитная обработка blur -> close -> dilate полосами строк (fused_blur_close_dilate).
+    // blurred и closed в этом режиме не заполняются.
+    bool fused_preprocess = false;
+    int strip_rows = 0; // 0 - подобрать по ширине кадра
+    WorkspaceBuffer strip_blurred_buffer;
+    WorkspaceBuffer strip_tmp_buffer;
+    WorkspaceBuffer strip_closed_buffer;
+
+    // Пирамидальный режим (run_pyramid_pipeline): грубый проход на PYRAMID_COARSE_ROWS строках
+    // находит рамку чека, полная цепочка идёт только по ней. pyramid_fallback - если контуров
+    // не нашлось, повторить полную цепочку по всему кадру.
+    bool pyramid = false;
+    bool pyramid_fallback = false;
+    WorkspaceBuffer coarse_gray_buffer;
+    cv::Mat coarse_gray;
+    cv::Rect roi;              // ROI последнего кадра в координатах TARGET_ROWS, пустой - грубый проход ничего не нашёл
+    double coarse_angle = -1.0; // угол по грубому контуру
+    size_t pyramid_roi_images = 0;
+    size_t pyramid_fallbacks = 0;
+    size_t pyramid_roi_pixels = 0;
+    size_t pyramid_frame_pixels = 0;
+
+    // Наибольший контур всегда внешний (вложенный лежит внутри объемлющего), поэтому иерархия
+    // по умолчанию не строится; RETR_TREE нужен, только если смотреть на вложенные контуры.
+    int contour_mode = cv::RETR_EXTERNAL;
+    std::vector<std::vector<cv::Point>> contours;
+    std::vector<cv::Vec4i> hierarchy;
+    ContourSelector selector;
+    // minAreaRect наибольшего контура последнего кадра в координатах resized (его строит process_image_batch)
+    cv::RotatedRect receipt_rect;
+    bool receipt_found = false;
+
+    // Время этапов текущего кадра; process_image_batch() обнуляет его в начале кадра
+    StageTimings timings;
+
+    size_t images = 0;
+    // Рост памяти самого рабочего пространства: хранилищ буферов, ёмкости списков контуров и иерархии,
+    // а также случаи, когда OpenCV положил результат этапа в свою память. steady_buffer_growth - то же
+    // без учёта первого кадра. Это не число выделений кучи: временную память внутри resize, GaussianBlur,
+    // Canny и findContours (и точки самих контуров) счётчик не видит.
+    size_t buffer_growth = 0;
+    size_t steady_buffer_growth = 0;
+    // Настоящие выделения кучи за process_image_batch / detect_receipts (alloc_counter.hpp), включая
+    // всё, что выделяет OpenCV внутри этапов; steady_heap_allocations - без первого кадра.
+    // Ноль не достигается: resize, GaussianBlur, Canny и findContours берут временную память на
+    // каждый вызов, и снаружи её не переиспользовать.
+    size_t heap_allocations = 0;
+    size_t steady_heap_allocations = 0;
+};
+
+// GaussianBlur(15x15, sigma 3) -> MORPH_CLOSE -> dilate полосами по strip_rows строк.
+// Каждая полоса считается с запасом fused_halo_rows() строк сверху и снизу, так что промежуточные
+// полосы остаются в L2, а результат побитно совпадает с последовательным применением трёх операций.
+int fused_halo_rows(const PipelineWorkspace& ws);
+int fused_strip_rows(int cols);
+void fused_blur_close_dilate(const cv::Mat& gray, cv::Mat& dst, PipelineWorkspace& ws);
+
+// resize -> gray -> GaussianBlur -> close -> dilate -> Canny -> findContours.
+// Результаты этапов остаются в ws; возвращает индекс наибольшего по площади контура или -1.
+int run_contour_pipeline(const cv::Mat& image, PipelineWorkspace& ws);
+// То же через пирамиду: контуры ищутся в ws.roi и возвращаются в координатах всего кадра.
+// При ws.pyramid process_image_batch использует этот вариант.
+int run_pyramid_pipeline(const cv::Mat& image, PipelineWorkspace& ws);
+
+// Несколько чеков в кадре (планшетный скан): кандидаты - внешние контуры площадью не меньше
+// min_area_fraction уменьшенного кадра, затем отбор по форме. Кандидаты перебираются по убыванию
+// площади последовательно: main_cw параллелит по файлам, а на кандидата - один minAreaRect.
+struct MultiReceiptOptions {
+    double min_area_fraction = 0.01;
+    double min_rectangularity = 0.6; // площадь контура / площадь его minAreaRect
+    double max_aspect = 12.0;        // длинная сторона / короткая
+    size_t max_candidates = 64;
+    size_t max_receipts = 16;
+};
+
+struct ReceiptDetection {
+    double angle = -1.0;  // как у calculateCheckAngle
+    double area = 0.0;    // площадь контура в уменьшенном кадре
+    cv::RotatedRect rect; // в координатах исходного кадра
+    cv::Rect bbox;        // в координатах исходного кадра
+};
+
+// Чеки по порядку сверху вниз, слева направо; пустой список - ничего не найдено.
+// Пирамидальный режим здесь не используется: ROI пирамиды строится вокруг одного чека.
+std::vector<ReceiptDetection> detect_receipts(const cv::Mat& image, PipelineWorkspace& ws,
+                                              const MultiReceiptOptions& options = MultiReceiptOptions());
+
+double process_image_batch(const cv::Mat& image, const std::string& file_path, PipelineWorkspace& ws);
+double process_image_batch(const cv::Mat& image, const std::string& file_path);
+double process_image_batch(const std::string& file_path);
+
+#endif // RECEIPT_PIPELINE_HPP
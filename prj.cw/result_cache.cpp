@@ -0,0 +1,119 @@
+#include "result_cache.hpp"
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <system_error>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static const char* const INDEX_HEADER = "# receipt_index 2";
+static const char* const NOT_FOUND_FIELD = "none";
+
+uint64_t fnv1a_64(const unsigned char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    // 0 зарезервирован под "не посчитан"
+    return hash != 0 ? hash : 1;
+}
+
+bool stat_file_identity(const fs::path& path, FileIdentity& identity) {
+    std::error_code ec;
+    uintmax_t size = fs::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+    fs::file_time_type mtime = fs::last_write_time(path, ec);
+    if (ec) {
+        return false;
+    }
+    identity.size = static_cast<uint64_t>(size);
+    identity.mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+    identity.hash = 0;
+    return true;
+}
+
+// Строка индекса: имя \t размер \t mtime \t хеш (hex) \t версия \t угол
+bool ResultIndex::load(const std::string& path) {
+    entries_.clear();
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        return false;
+    }
+    std::string line;
+    if (!std::getline(in, line) || line != INDEX_HEADER) {
+        return false;
+    }
+    while (std::getline(in, line)) {
+        std::vector<std::string> fields;
+        std::istringstream row(line);
+        std::string field;
+        while (std::getline(row, field, '\t')) {
+            fields.push_back(field);
+        }
+        if (fields.size() != 6) {
+            continue;
+        }
+        IndexEntry entry;
+        try {
+            entry.identity.size = std::stoull(fields[1]);
+            entry.identity.mtime = std::stoll(fields[2]);
+            entry.identity.hash = std::stoull(fields[3], nullptr, 16);
+            entry.version = fields[4];
+            // "none" - чек не найден; пустое поле в конце строки getline не вернёт
+            entry.found = fields[5] != NOT_FOUND_FIELD;
+            if (entry.found) {
+                entry.angle = std::stod(fields[5]);
+            }
+        } catch (const std::exception&) {
+            continue;
+        }
+        entries_[fields[0]] = entry;
+    }
+    return true;
+}
+
+bool ResultIndex::save(const std::string& path) const {
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path);
+        if (!out.is_open()) {
+            return false;
+        }
+        out << INDEX_HEADER << "\n" << std::setprecision(17);
+        for (const auto& item : entries_) {
+            const IndexEntry& entry = item.second;
+            out << item.first << "\t" << entry.identity.size << "\t" << entry.identity.mtime << "\t"
+                << std::hex << entry.identity.hash << std::dec << "\t" << entry.version << "\t";
+            if (entry.found) {
+                out << entry.angle;
+            } else {
+                out << NOT_FOUND_FIELD;
+            }
+            out << "\n";
+        }
+        if (!out) {
+            return false;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp_path, path, ec);
+    return !ec;
+}
+
+const IndexEntry* ResultIndex::find(const std::string& filename) const {
+    auto it = entries_.find(filename);
+    return it != entries_.end() ? &it->second : nullptr;
+}
+
+void ResultIndex::put(const std::string& filename, const IndexEntry& entry) {
+    // Имена с табуляцией или переводом строки сломали бы формат - такие файлы просто не кешируются
+    if (filename.find_first_of("\t\n\r") != std::string::npos) {
+        return;
+    }
+    entries_[filename] = entry;
+}
@@ -0,0 +1,47 @@
+#ifndef RESULT_CACHE_HPP
+#define RESULT_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+
+// Индекс результатов пакетного режима для инкрементальных запусков (--index).
+// Файл считается неизменным, если совпали размер и mtime; если изменился только mtime
+// (копирование, touch), сравнивается хеш содержимого. Результат годен, только если
+// совпадает и версия конвейера (pipeline_version в main_cw).
+struct FileIdentity {
+    uint64_t size = 0;
+    int64_t mtime = 0; // тики std::filesystem::file_time_type
+    uint64_t hash = 0; // FNV-1a 64 содержимого, 0 - ещё не посчитан
+};
+
+struct IndexEntry {
+    FileIdentity identity;
+    std::string version;
+    bool found = false; // чек не найден - angle не используется
+    double angle = 0.0;
+};
+
+uint64_t fnv1a_64(const unsigned char* data, size_t size);
+bool stat_file_identity(const std::filesystem::path& path, FileIdentity& identity);
+
+class ResultIndex {
+public:
+    // Отсутствующий или повреждённый индекс - не ошибка, а пустой индекс: тогда обрабатывается всё.
+    bool load(const std::string& path);
+    // Пишет во временный файл рядом и переименовывает, чтобы прерванный запуск не испортил индекс.
+    bool save(const std::string& path) const;
+
+    const IndexEntry* find(const std::string& filename) const;
+    void put(const std::string& filename, const IndexEntry& entry);
+    size_t size() const {
+        return entries_.size();
+    }
+
+private:
+    std::map<std::string, IndexEntry> entries_;
+};
+
+#endif // RESULT_CACHE_HPP
@@ -0,0 +1,118 @@
+#include "skew_projection.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+double angle_difference_mod180(double a, double b) {
+    double diff = std::fmod(std::fabs(a - b), 180.0);
+    return std::min(diff, 180.0 - diff);
+}
+
+static double normalize_mod180(double angle) {
+    angle = std::fmod(angle, 180.0);
+    if (angle <= -90.0) angle += 180.0;
+    if (angle > 90.0) angle -= 180.0;
+    return angle;
+}
+
+// Профиль проекции точек на нормаль к направлению angle_deg, бины по 1 пикселю.
+// Индексы бинов считаются отдельным проходом без ветвлений, который компилятор векторизует,
+// затем идёт разброс по гистограмме.
+static double projection_score(const std::vector<float>& xs, const std::vector<float>& ys, double angle_deg,
+                               float radius, std::vector<int>& bin_index, std::vector<int>& profile) {
+    const double a = angle_deg * CV_PI / 180.0;
+    const float nx = static_cast<float>(-std::sin(a));
+    const float ny = static_cast<float>(std::cos(a));
+    const size_t n = xs.size();
+    const float* px = xs.data();
+    const float* py = ys.data();
+    int* idx = bin_index.data();
+
+    for (size_t i = 0; i < n; ++i) {
+        idx[i] = static_cast<int>(px[i] * nx + py[i] * ny + radius);
+    }
+
+    std::fill(profile.begin(), profile.end(), 0);
+    int* bins = profile.data();
+    for (size_t i = 0; i < n; ++i) {
+        ++bins[idx[i]];
+    }
+
+    double score = 0.0;
+    for (int count : profile) {
+        score += static_cast<double>(count) * count;
+    }
+    return score;
+}
+
+SkewEstimate estimate_skew_projection(const cv::Mat& image, const SkewProjectionOptions& options) {
+    SkewEstimate estimate;
+    if (image.empty()) {
+        return estimate;
+    }
+
+    double ratio = std::min(1.0, static_cast<double>(options.target_rows) / image.rows);
+    cv::Mat small;
+    if (ratio < 1.0) {
+        cv::resize(image, small, cv::Size(), ratio, ratio, cv::INTER_AREA);
+    } else {
+        small = image;
+    }
+
+    cv::Mat gray;
+    if (small.channels() == 1) {
+        gray = small;
+    } else {
+        cv::cvtColor(small, gray, cv::COLOR_BGR2GRAY);
+    }
+
+    // Штрихи текста темнее локального фона
+    cv::Mat ink;
+    cv::adaptiveThreshold(gray, ink, 255, cv::ADAPTIVE_THRESH_MEAN_C, cv::THRESH_BINARY_INV, 15, 10);
+
+    const float cx = 0.5f * (ink.cols - 1);
+    const float cy = 0.5f * (ink.rows - 1);
+    std::vector<float> xs;
+    std::vector<float> ys;
+    for (int y = 0; y < ink.rows; ++y) {
+        const uchar* row = ink.ptr<uchar>(y);
+        for (int x = 0; x < ink.cols; ++x) {
+            if (row[x]) {
+                xs.push_back(x - cx);
+                ys.push_back(y - cy);
+            }
+        }
+    }
+    estimate.points = static_cast<int>(xs.size());
+    if (estimate.points < options.min_points) {
+        return estimate;
+    }
+
+    const float radius = std::ceil(0.5f * std::sqrt(static_cast<float>(ink.cols * ink.cols + ink.rows * ink.rows))) + 1.0f;
+    std::vector<int> bin_index(xs.size());
+    std::vector<int> profile(static_cast<size_t>(2 * radius) + 2);
+
+    double best_angle = 0.0;
+    double best_score = -1.0;
+    for (double angle = -90.0; angle < 90.0; angle += options.coarse_step) {
+        double score = projection_score(xs, ys, angle, radius, bin_index, profile);
+        if (score > best_score) {
+            best_score = score;
+            best_angle = angle;
+        }
+    }
+
+    const double coarse_best = best_angle;
+    for (double angle = coarse_best - options.coarse_step; angle <= coarse_best + options.coarse_step; angle += options.fine_step) {
+        double score = projection_score(xs, ys, angle, radius, bin_index, profile);
+        if (score > best_score) {
+            best_score = score;
+            best_angle = angle;
+        }
+    }
+
+    estimate.found = true;
+    estimate.text_angle = normalize_mod180(best_angle);
+    estimate.angle = normalize_mod180(best_angle + 90.0);
+    return estimate;
+}
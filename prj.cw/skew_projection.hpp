@@ -0,0 +1,34 @@
+#ifndef SKEW_PROJECTION_HPP
+#define SKEW_PROJECTION_HPP
+
+#include <opencv2/opencv.hpp>
+
+// Оценка наклона чека по проекционным профилям строк текста - быстрая альтернатива
+// цепочке Canny + findContours + minAreaRect. Кадр уменьшается до target_rows строк,
+// тёмные штрихи текста выделяются адаптивным порогом, затем ищется угол, при котором
+// проекция штрихов на нормаль к строкам даёт самые резкие пики (максимум суммы квадратов
+// по бинам профиля). Поиск грубый (coarse_step по всему полукругу), затем точный
+// (fine_step вокруг лучшего грубого угла).
+struct SkewProjectionOptions {
+    int target_rows = 200;
+    double coarse_step = 2.0;
+    double fine_step = 0.1;
+    int min_points = 50;
+};
+
+struct SkewEstimate {
+    bool found = false;
+    // Угол длинной стороны чека (перпендикуляр к строкам текста) в градусах в тех же осях,
+    // что и calculateCheckAngle(); направление не определено, поэтому значение в (-90, 90].
+    // Имеет смысл только при found.
+    double angle = 0.0;
+    double text_angle = 0.0; // угол строк текста
+    int points = 0;
+};
+
+SkewEstimate estimate_skew_projection(const cv::Mat& image, const SkewProjectionOptions& options = SkewProjectionOptions());
+
+// Разница двух углов сторон, не различающая направление: результат в [0, 90].
+double angle_difference_mod180(double a, double b);
+
+#endif // SKEW_PROJECTION_HPP
@@ -0,0 +1,78 @@
+#ifndef STAGE_TIMER_HPP
+#define STAGE_TIMER_HPP
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+// Этапы конвейера поиска чека. В слитном режиме (--fused) blur, close и dilate
+// идут одним этапом FusedPreprocess.
+enum class Stage {
+    Imread,
+    Resize,
+    CvtColor,
+    GaussianBlur,
+    Morphology,
+    Dilate,
+    FusedPreprocess,
+    Canny,
+    FindContours,
+    SelectContour,
+    MinAreaRect,
+    Count
+};
+
+const size_t STAGE_COUNT = static_cast<size_t>(Stage::Count);
+
+inline const char* stage_name(Stage stage) {
+    static const char* const names[STAGE_COUNT] = {
+        "imread", "resize", "cvtColor", "GaussianBlur", "morphology", "dilate",
+        "fused_preprocess", "Canny", "findContours", "select_contour", "minAreaRect"
+    };
+    return names[static_cast<size_t>(stage)];
+}
+
+// Время этапов одного кадра в миллисекундах
+struct StageTimings {
+    bool enabled = false;
+    std::array<double, STAGE_COUNT> ms{};
+
+    void clear() {
+        ms.fill(0.0);
+    }
+
+    double& operator[](Stage stage) {
+        return ms[static_cast<size_t>(stage)];
+    }
+
+    double operator[](Stage stage) const {
+        return ms[static_cast<size_t>(stage)];
+    }
+};
+
+// Замеряет этап до конца области видимости по steady_clock. Когда замеры выключены,
+// вся цена - проверка флага в конструкторе и деструкторе.
+class ScopedStage {
+public:
+    ScopedStage(StageTimings& timings, Stage stage) : timings_(timings), stage_(stage) {
+        if (timings_.enabled) {
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedStage() {
+        if (timings_.enabled) {
+            timings_[stage_] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+        }
+    }
+
+    ScopedStage(const ScopedStage&) = delete;
+    ScopedStage& operator=(const ScopedStage&) = delete;
+
+private:
+    StageTimings& timings_;
+    Stage stage_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#endif // STAGE_TIMER_HPP
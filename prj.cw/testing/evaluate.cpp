@@ -0,0 +1,401 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "cli_args.hpp"
+#include "receipt_pipeline.hpp"
+#include "skew_projection.hpp"
+#include "via_index.hpp"
+
+namespace fs = std::filesystem;
+
+// Оценка точности и скорости конвейера по разметке VIA (points.json):
+// углы process_image_batch() сравниваются с углом длинной стороны размеченного многоугольника.
+
+struct EvalOptions {
+    std::string annotations;
+    std::string images_dir;
+    std::string csv_file;
+    int workers = 0;
+    int close_size = 15; // как у main_cw
+    int dilate_size = 9;
+    bool reduced_decode = false;
+    bool fused_preprocess = false;
+    bool pyramid = false;
+    bool pyramid_fallback = false;
+    bool compare_full = false; // проверить пирамиду: тот же кадр ещё раз в полном разрешении
+    std::string engine = "contour";
+};
+
+struct EvalItem {
+    std::string filename;
+    double gt_angle = 0.0;
+    bool has_gt = false;
+    bool missing = false;  // файла нет или не декодировался
+    bool detected = false;
+    double angle = 0.0;
+    double error = 0.0;
+    double decode_ms = 0.0;
+    double detect_ms = 0.0;
+    // --compare-full: результат без пирамиды
+    bool full_detected = false;
+    double full_angle = 0.0;
+};
+
+// Угол эталона - calculateCheckAngle() по наибольшему многоугольнику разметки, то есть в тех же
+// осях и с той же неоднозначностью направления, что и у детектора; сравнение по модулю 180.
+bool ground_truth_angle(const ImageData& data, double& angle) {
+    double best_area = 0.0;
+    const Polygon* best = nullptr;
+    for (const auto& poly : data.polygons) {
+        if (poly.points.size() < 4) {
+            continue;
+        }
+        double area = std::abs(cv::contourArea(poly.points));
+        if (best == nullptr || area > best_area) {
+            best_area = area;
+            best = &poly;
+        }
+    }
+    if (best == nullptr) {
+        return false;
+    }
+    std::vector<cv::Point> contour;
+    contour.reserve(best->points.size());
+    for (const auto& p : best->points) {
+        contour.emplace_back(cvRound(p.x), cvRound(p.y));
+    }
+    angle = calculateCheckAngle(contour);
+    return true;
+}
+
+cv::Mat load_eval_image(const std::string& path, bool reduced_decode) {
+    if (!reduced_decode) {
+        return cv::imread(path, cv::IMREAD_COLOR);
+    }
+    semcv::MappedFile file(path);
+    if (!file.is_open()) {
+        return cv::Mat();
+    }
+    return decode_reduced_gray(file.data(), file.size());
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void evaluate_item(EvalItem& item, const EvalOptions& options, PipelineWorkspace& ws, PipelineWorkspace& full_ws) {
+    std::string path = (fs::path(options.images_dir) / item.filename).string();
+
+    // Исключение на одном файле не должно ронять весь прогон: ошибка декодирования - missing,
+    // ошибка конвейера - not_found
+    auto start = std::chrono::steady_clock::now();
+    cv::Mat image;
+    try {
+        image = load_eval_image(path, options.reduced_decode);
+    } catch (const std::exception& e) {
+        std::cerr << "Ошибка при декодировании файла " << path << ": " << e.what() << std::endl;
+    }
+    item.decode_ms = elapsed_ms(start);
+    if (image.empty()) {
+        item.missing = true;
+        return;
+    }
+
+    start = std::chrono::steady_clock::now();
+    try {
+        if (options.engine == "projection") {
+            SkewEstimate estimate = estimate_skew_projection(image);
+            item.detected = estimate.found;
+            item.angle = estimate.angle;
+        } else {
+            item.angle = process_image_batch(image, path, ws);
+            item.detected = ws.receipt_found;
+        }
+    } catch (const std::exception& e) {
+        item.detected = false;
+        std::cerr << "Ошибка при обработке файла " << path << ": " << e.what() << std::endl;
+    }
+    item.detect_ms = elapsed_ms(start);
+
+    if (options.compare_full) {
+        try {
+            item.full_angle = process_image_batch(image, path, full_ws);
+            item.full_detected = full_ws.receipt_found;
+        } catch (const std::exception& e) {
+            item.full_detected = false;
+            std::cerr << "Ошибка при обработке файла " << path << " в полном разрешении: " << e.what() << std::endl;
+        }
+    }
+
+    if (item.detected) {
+        item.error = angle_difference_mod180(item.angle, item.gt_angle);
+    }
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+double mean(const std::vector<double>& values) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    double sum = 0.0;
+    for (double v : values) {
+        sum += v;
+    }
+    return sum / values.size();
+}
+
+void print_distribution(const std::string& name, std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    std::cout << name << ": среднее " << mean(values)
+              << ", p50 " << percentile(values, 0.50)
+              << ", p90 " << percentile(values, 0.90)
+              << ", p95 " << percentile(values, 0.95)
+              << ", p99 " << percentile(values, 0.99)
+              << ", макс. " << (values.empty() ? 0.0 : values.back()) << "\n";
+}
+
+bool write_csv(const std::string& path, const std::vector<EvalItem>& items) {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        return false;
+    }
+    out << "filename,gt_angle,angle,error,decode_ms,detect_ms,status\n";
+    for (const auto& item : items) {
+        const char* status = item.missing ? "missing" : (item.detected ? "ok" : "not_found");
+        // Без найденного чека угол и ошибка - NOT_FOUND_ANGLE, статус not_found
+        out << item.filename << "," << item.gt_angle << "," << (item.detected ? item.angle : NOT_FOUND_ANGLE) << ","
+            << (item.detected ? item.error : NOT_FOUND_ANGLE) << ","
+            << item.decode_ms << "," << item.detect_ms << "," << status << "\n";
+    }
+    return true;
+}
+
+// Пирамида должна давать тот же чек, что и полное разрешение: считаем кадры, где угол
+// разошёлся больше допуска или чек нашёлся только одним из вариантов
+void print_pyramid_agreement(const std::vector<EvalItem>& items) {
+    const double tolerance = 0.5;
+    size_t compared = 0;
+    size_t differ = 0;
+    size_t only_pyramid = 0;
+    size_t only_full = 0;
+    double max_difference = 0.0;
+    for (const auto& item : items) {
+        if (item.missing) {
+            continue;
+        }
+        ++compared;
+        if (item.detected != item.full_detected) {
+            ++(item.detected ? only_pyramid : only_full);
+            std::cout << item.filename << ": чек найден только " << (item.detected ? "пирамидой" : "в полном разрешении") << "\n";
+            continue;
+        }
+        if (!item.detected) {
+            continue;
+        }
+        double difference = angle_difference_mod180(item.angle, item.full_angle);
+        max_difference = std::max(max_difference, difference);
+        if (difference > tolerance) {
+            ++differ;
+            std::cout << item.filename << ": пирамида " << item.angle << ", полное разрешение " << item.full_angle << "\n";
+        }
+    }
+    std::cout << "Пирамида и полное разрешение: кадров " << compared
+              << ", угол расходится больше " << tolerance << " градуса: " << differ
+              << ", чек найден только пирамидой: " << only_pyramid
+              << ", только в полном разрешении: " << only_full
+              << ", макс. расхождение " << max_difference << " градусов\n";
+}
+
+int run_evaluation(const EvalOptions& options) {
+    ViaAnnotationIndex annotations;
+    if (!annotations.open(options.annotations)) {
+        return 1;
+    }
+
+    // Индекс уже упорядочен по имени файла
+    std::vector<EvalItem> items;
+    size_t without_gt = 0;
+    ImageData data;
+    for (size_t i = 0; i < annotations.size(); ++i) {
+        EvalItem item;
+        item.filename = annotations.filename(i);
+        annotations.polygons(i, data.polygons);
+        item.has_gt = ground_truth_angle(data, item.gt_angle);
+        if (item.has_gt) {
+            items.push_back(item);
+        } else {
+            ++without_gt;
+        }
+    }
+    if (items.empty()) {
+        std::cerr << "В разметке нет многоугольников" << std::endl;
+        return 1;
+    }
+
+    int workers = options.workers;
+    if (workers <= 0) {
+        unsigned int hw = std::thread::hardware_concurrency();
+        workers = hw > 0 ? static_cast<int>(hw) : 1;
+    }
+    workers = std::min<int>(workers, static_cast<int>(items.size()));
+    // Параллелим по файлам, внутренние потоки OpenCV только мешали бы
+    cv::setNumThreads(1);
+
+    std::atomic<size_t> next(0);
+    auto wall_start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < workers; ++t) {
+        threads.emplace_back([&]() {
+            PipelineWorkspace ws(options.close_size, options.dilate_size);
+            ws.fused_preprocess = options.fused_preprocess;
+            ws.pyramid = options.pyramid;
+            ws.pyramid_fallback = options.pyramid_fallback;
+            PipelineWorkspace full_ws(options.close_size, options.dilate_size);
+            full_ws.fused_preprocess = options.fused_preprocess;
+            for (size_t i = next++; i < items.size(); i = next++) {
+                evaluate_item(items[i], options, ws, full_ws);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double wall_ms = elapsed_ms(wall_start);
+
+    std::vector<double> errors, decode_ms, detect_ms, total_ms;
+    size_t missing = 0;
+    size_t not_found = 0;
+    std::cout << std::fixed << std::setprecision(2);
+    for (const auto& item : items) {
+        if (item.missing) {
+            ++missing;
+            std::cout << item.filename << ": файл не найден или не читается\n";
+            continue;
+        }
+        decode_ms.push_back(item.decode_ms);
+        detect_ms.push_back(item.detect_ms);
+        total_ms.push_back(item.decode_ms + item.detect_ms);
+        if (!item.detected) {
+            ++not_found;
+            std::cout << item.filename << ": эталон " << item.gt_angle << ", чек не найден"
+                      << ", время " << item.decode_ms << " + " << item.detect_ms << " мс\n";
+            continue;
+        }
+        errors.push_back(item.error);
+        std::cout << item.filename << ": эталон " << item.gt_angle << ", найдено " << item.angle
+                  << ", ошибка " << item.error
+                  << ", время " << item.decode_ms << " + " << item.detect_ms << " мс\n";
+    }
+
+    size_t processed = items.size() - missing;
+    std::cout << "\nРазмечено изображений: " << items.size()
+              << " (без многоугольника пропущено: " << without_gt << ")"
+              << "; не найдено файлов: " << missing
+              << "; чек не найден: " << not_found << "\n";
+    if (!errors.empty()) {
+        size_t within[3] = {0, 0, 0};
+        const double limits[3] = {1.0, 2.0, 5.0};
+        for (double e : errors) {
+            for (int k = 0; k < 3; ++k) {
+                if (e <= limits[k]) {
+                    ++within[k];
+                }
+            }
+        }
+        print_distribution("Ошибка угла, градусы", errors);
+        std::cout << "Доля с ошибкой не больше 1/2/5 градусов (от обработанных): ";
+        for (int k = 0; k < 3; ++k) {
+            std::cout << (k > 0 ? " / " : "") << 100.0 * within[k] / processed << "%";
+        }
+        std::cout << "\n";
+    }
+    if (!total_ms.empty()) {
+        print_distribution("Декодирование, мс", decode_ms);
+        print_distribution("Поиск угла, мс", detect_ms);
+        print_distribution("Всего на изображение, мс", total_ms);
+    }
+    if (options.compare_full) {
+        print_pyramid_agreement(items);
+    }
+    std::cout << "Потоков: " << workers << ", общее время " << wall_ms << " мс, "
+              << (wall_ms > 0.0 ? processed * 1000.0 / wall_ms : 0.0) << " изображений/с\n";
+
+    if (!options.csv_file.empty() && !write_csv(options.csv_file, items)) {
+        std::cerr << "Не удалось записать " << options.csv_file << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+void print_usage(const char* prog) {
+    std::cout << "Использование: " << prog << " <points.json> <папка с изображениями> [--workers <N>]\n"
+              << "    [--reduced-decode] [--fused] [--pyramid] [--pyramid-fallback] [--compare-full]\n"
+              << "    [--close-size <N>] [--dilate-size <N>] [--engine contour|projection] [--csv <файл>]\n";
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    EvalOptions options;
+    options.annotations = argv[1];
+    options.images_dir = argv[2];
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool valid = true;
+        if (arg == "--workers" && i + 1 < argc) {
+            valid = parse_positive(argv[++i], options.workers);
+        } else if (arg == "--close-size" && i + 1 < argc) {
+            valid = parse_positive(argv[++i], options.close_size);
+        } else if (arg == "--dilate-size" && i + 1 < argc) {
+            valid = parse_positive(argv[++i], options.dilate_size);
+        } else if (arg == "--reduced-decode") {
+            options.reduced_decode = true;
+        } else if (arg == "--fused") {
+            options.fused_preprocess = true;
+        } else if (arg == "--pyramid") {
+            options.pyramid = true;
+        } else if (arg == "--pyramid-fallback") {
+            options.pyramid = true;
+            options.pyramid_fallback = true;
+        } else if (arg == "--compare-full") {
+            options.compare_full = true;
+        } else if (arg == "--engine" && i + 1 < argc) {
+            options.engine = argv[++i];
+            valid = options.engine == "contour" || options.engine == "projection";
+        } else if (arg == "--csv" && i + 1 < argc) {
+            options.csv_file = argv[++i];
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.compare_full && (!options.pyramid || options.engine != "contour")) {
+        std::cerr << "--compare-full проверяет пирамиду контурного движка: нужен --pyramid" << std::endl;
+        return 1;
+    }
+
+    return run_evaluation(options);
+}
@@ -0,0 +1,19 @@
+#ifndef VIA_ANNOTATIONS_HPP
+#define VIA_ANNOTATIONS_HPP
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Разметка чеков из VIA (VGG Image Annotator): многоугольники по файлам из points.json.
+// Читается через ViaAnnotationIndex (via_index.hpp).
+struct Polygon {
+    std::vector<cv::Point2f> points;
+};
+
+struct ImageData {
+    std::string filename;
+    std::vector<Polygon> polygons;
+};
+
+#endif // VIA_ANNOTATIONS_HPP
@@ -0,0 +1,388 @@
+#include "via_index.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <string_view>
+#include <nlohmann/json.hpp>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+
+const char VIA_INDEX_MAGIC[8] = {'V', 'I', 'A', 'I', 'D', 'X', '\0', '\0'};
+
+bool source_identity(const std::string& path, uint64_t& size, int64_t& mtime) {
+    std::error_code ec;
+    uintmax_t file_size = fs::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+    fs::file_time_type file_mtime = fs::last_write_time(path, ec);
+    if (ec) {
+        return false;
+    }
+    size = static_cast<uint64_t>(file_size);
+    mtime = static_cast<int64_t>(file_mtime.time_since_epoch().count());
+    return true;
+}
+
+// SAX-обработчик: держит в памяти только путь от корня и текущий многоугольник,
+// точки сразу дописываются в файл индекса.
+// Нужная часть points.json: {"_via_img_metadata": {"<ключ>": {"filename": ...,
+//   "regions": [{"shape_attributes": {"name": "polygon", "all_points_x": [...], "all_points_y": [...]}}]}}}
+class ViaIndexBuilder : public nlohmann::json_sax<json> {
+public:
+    explicit ViaIndexBuilder(std::ofstream& out) : out_(out) {}
+
+    bool null() override {
+        return true;
+    }
+    bool boolean(bool) override {
+        return true;
+    }
+    bool number_integer(number_integer_t value) override {
+        add_coordinate(static_cast<float>(value));
+        return true;
+    }
+    bool number_unsigned(number_unsigned_t value) override {
+        add_coordinate(static_cast<float>(value));
+        return true;
+    }
+    bool number_float(number_float_t value, const string_t&) override {
+        add_coordinate(static_cast<float>(value));
+        return true;
+    }
+    bool string(string_t& value) override {
+        if (in_image() && key_ == "filename") {
+            image_.name_offset = names.size();
+            image_.name_size = static_cast<uint32_t>(value.size());
+            names += value;
+            has_name_ = true;
+        } else if (in_shape() && key_ == "name") {
+            is_polygon_ = value == "polygon";
+        }
+        return true;
+    }
+    bool binary(binary_t&) override {
+        return true;
+    }
+    bool start_object(std::size_t) override {
+        enter();
+        if (in_image()) {
+            image_ = ViaIndexImage();
+            image_.first_polygon = polygons.size();
+            has_name_ = false;
+        } else if (in_shape()) {
+            xs_.clear();
+            ys_.clear();
+            is_polygon_ = false;
+        }
+        return true;
+    }
+    bool key(string_t& value) override {
+        key_ = value;
+        return true;
+    }
+    bool end_object() override {
+        if (in_shape()) {
+            finish_polygon();
+        } else if (in_image()) {
+            finish_image();
+        }
+        leave();
+        return true;
+    }
+    bool start_array(std::size_t) override {
+        enter();
+        return true;
+    }
+    bool end_array() override {
+        leave();
+        return true;
+    }
+    bool parse_error(std::size_t position, const std::string& last_token, const nlohmann::detail::exception& e) override {
+        std::cerr << "JSON parse error at " << position << " near '" << last_token << "': " << e.what() << std::endl;
+        return false;
+    }
+
+    std::vector<ViaIndexPolygon> polygons;
+    std::vector<ViaIndexImage> images;
+    std::string names;
+    uint64_t points = 0;
+
+private:
+    void enter() {
+        path_.push_back(key_);
+        key_.clear();
+    }
+    void leave() {
+        path_.pop_back();
+        key_.clear();
+    }
+
+    bool in_metadata() const {
+        return path_.size() >= 3 && path_[1] == "_via_img_metadata";
+    }
+    bool in_image() const {
+        return path_.size() == 3 && in_metadata();
+    }
+    bool in_shape() const {
+        return path_.size() == 6 && in_metadata() && path_[3] == "regions" && path_[5] == "shape_attributes";
+    }
+
+    void add_coordinate(float value) {
+        if (path_.size() != 7 || !in_metadata() || path_[3] != "regions" || path_[5] != "shape_attributes") {
+            return;
+        }
+        if (path_[6] == "all_points_x") {
+            xs_.push_back(value);
+        } else if (path_[6] == "all_points_y") {
+            ys_.push_back(value);
+        }
+    }
+
+    void finish_polygon() {
+        if (!is_polygon_) {
+            return;
+        }
+        size_t count = std::min(xs_.size(), ys_.size());
+        ViaIndexPolygon polygon = {};
+        polygon.first_point = points;
+        polygon.point_count = static_cast<uint32_t>(count);
+        for (size_t i = 0; i < count; ++i) {
+            const float xy[2] = {xs_[i], ys_[i]};
+            out_.write(reinterpret_cast<const char*>(xy), sizeof(xy));
+        }
+        points += count;
+        polygons.push_back(polygon);
+    }
+
+    void finish_image() {
+        if (!has_name_) {
+            polygons.resize(image_.first_polygon);
+            return;
+        }
+        image_.polygon_count = static_cast<uint32_t>(polygons.size() - image_.first_polygon);
+        images.push_back(image_);
+    }
+
+    std::ofstream& out_;
+    std::vector<std::string> path_; // ключи от корня, у элементов массивов - пустые
+    std::string key_;
+    ViaIndexImage image_ = {};
+    bool has_name_ = false;
+    bool is_polygon_ = false;
+    std::vector<float> xs_;
+    std::vector<float> ys_;
+};
+
+std::string_view image_name(const ViaIndexImage& image, const char* names) {
+    return std::string_view(names + image.name_offset, image.name_size);
+}
+
+// first + count <= total; значения берутся из файла, поэтому сумма не вычисляется (переполнение)
+bool range_fits(uint64_t first, uint64_t count, uint64_t total) {
+    return first <= total && count <= total - first;
+}
+
+// Таблица count элементов по size байт с offset лежит в [begin, end) и выровнена под align
+bool table_fits(uint64_t offset, uint64_t count, uint64_t size, uint64_t align, uint64_t begin, uint64_t end) {
+    return offset >= begin && offset <= end && offset % align == 0 && count <= (end - offset) / size;
+}
+
+} // namespace
+
+bool build_via_index(const std::string& json_path, const std::string& index_path) {
+    ViaIndexHeader header = {};
+    std::memcpy(header.magic, VIA_INDEX_MAGIC, sizeof(header.magic));
+    header.version = VIA_INDEX_VERSION;
+    if (!source_identity(json_path, header.source_size, header.source_mtime)) {
+        std::cerr << "Failed to open input file: " << json_path << std::endl;
+        return false;
+    }
+    std::ifstream input_file(json_path, std::ios::binary);
+    if (!input_file.is_open()) {
+        std::cerr << "Failed to open input file: " << json_path << std::endl;
+        return false;
+    }
+
+    // Пишем во временный файл и переименовываем, чтобы параллельный запуск не увидел недописанный индекс
+    std::string tmp_path = index_path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Failed to create index: " << tmp_path << std::endl;
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    ViaIndexBuilder builder(out);
+    bool parsed = false;
+    try {
+        parsed = json::sax_parse(input_file, &builder);
+    } catch (const std::exception& e) {
+        std::cerr << "JSON parse error: " << e.what() << std::endl;
+    }
+    if (!parsed) {
+        out.close();
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    std::vector<size_t> order(builder.images.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return image_name(builder.images[a], builder.names.data()) < image_name(builder.images[b], builder.names.data());
+    });
+
+    header.image_count = builder.images.size();
+    header.polygon_count = builder.polygons.size();
+    header.point_count = builder.points;
+    header.points_offset = sizeof(header);
+    header.polygons_offset = header.points_offset + builder.points * 2 * sizeof(float);
+    header.images_offset = header.polygons_offset + builder.polygons.size() * sizeof(ViaIndexPolygon);
+    header.names_offset = header.images_offset + builder.images.size() * sizeof(ViaIndexImage);
+    header.names_size = builder.names.size();
+
+    out.write(reinterpret_cast<const char*>(builder.polygons.data()), builder.polygons.size() * sizeof(ViaIndexPolygon));
+    for (size_t i : order) {
+        out.write(reinterpret_cast<const char*>(&builder.images[i]), sizeof(ViaIndexImage));
+    }
+    out.write(builder.names.data(), static_cast<std::streamsize>(builder.names.size()));
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+    if (!out) {
+        std::cerr << "Failed to write index: " << tmp_path << std::endl;
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    std::error_code ec;
+    fs::rename(tmp_path, index_path, ec);
+    if (ec) {
+        std::cerr << "Failed to write index: " << index_path << std::endl;
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ViaAnnotationIndex::open(const std::string& json_path, const std::string& index_path) {
+    std::string path = index_path.empty() ? json_path + ".idx" : index_path;
+
+    uint64_t source_size = 0;
+    int64_t source_mtime = 0;
+    bool have_source = source_identity(json_path, source_size, source_mtime);
+
+    file_ = semcv::MappedFile(path, semcv::ReadAdvice::Normal);
+    if (attach() && (!have_source || (header_->source_size == source_size && header_->source_mtime == source_mtime))) {
+        return true;
+    }
+    if (!have_source) {
+        std::cerr << "Failed to open input file: " << json_path << std::endl;
+        return false;
+    }
+
+    file_.close();
+    header_ = nullptr;
+    if (!build_via_index(json_path, path)) {
+        return false;
+    }
+    file_ = semcv::MappedFile(path, semcv::ReadAdvice::Normal);
+    if (!attach()) {
+        std::cerr << "Corrupted index: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Проверяет заголовок, что все таблицы помещаются в файл и что каждая ссылка из таблиц
+// (имя, многоугольники изображения, точки многоугольника) не выходит за свою таблицу.
+// Проход по таблицам линейный, зато запросы дальше обходятся без проверок.
+bool ViaAnnotationIndex::attach() {
+    header_ = nullptr;
+    if (!file_.is_open() || file_.size() < sizeof(ViaIndexHeader)) {
+        return false;
+    }
+    const auto* header = reinterpret_cast<const ViaIndexHeader*>(file_.data());
+    if (std::memcmp(header->magic, VIA_INDEX_MAGIC, sizeof(header->magic)) != 0 || header->version != VIA_INDEX_VERSION) {
+        return false;
+    }
+    const uint64_t file_size = file_.size();
+    if (!table_fits(header->points_offset, header->point_count, 2 * sizeof(float), alignof(float),
+                    sizeof(ViaIndexHeader), header->polygons_offset)
+        || !table_fits(header->polygons_offset, header->polygon_count, sizeof(ViaIndexPolygon), alignof(ViaIndexPolygon),
+                       header->points_offset, header->images_offset)
+        || !table_fits(header->images_offset, header->image_count, sizeof(ViaIndexImage), alignof(ViaIndexImage),
+                       header->polygons_offset, header->names_offset)
+        || !table_fits(header->names_offset, header->names_size, 1, 1, header->images_offset, file_size)) {
+        return false;
+    }
+
+    const char* base = reinterpret_cast<const char*>(file_.data());
+    const auto* polygons = reinterpret_cast<const ViaIndexPolygon*>(base + header->polygons_offset);
+    const auto* images = reinterpret_cast<const ViaIndexImage*>(base + header->images_offset);
+    for (uint64_t p = 0; p < header->polygon_count; ++p) {
+        if (!range_fits(polygons[p].first_point, polygons[p].point_count, header->point_count)) {
+            return false;
+        }
+    }
+    for (uint64_t i = 0; i < header->image_count; ++i) {
+        if (!range_fits(images[i].name_offset, images[i].name_size, header->names_size)
+            || !range_fits(images[i].first_polygon, images[i].polygon_count, header->polygon_count)) {
+            return false;
+        }
+    }
+
+    header_ = header;
+    points_ = reinterpret_cast<const float*>(base + header->points_offset);
+    polygons_ = polygons;
+    images_ = images;
+    names_ = base + header->names_offset;
+    return true;
+}
+
+std::string ViaAnnotationIndex::filename(size_t i) const {
+    return std::string(image_name(images_[i], names_));
+}
+
+void ViaAnnotationIndex::polygons(size_t i, std::vector<Polygon>& out) const {
+    out.clear();
+    append_polygons(images_[i], out);
+}
+
+bool ViaAnnotationIndex::find(const std::string& filename, std::vector<Polygon>& out) const {
+    out.clear();
+    if (header_ == nullptr) {
+        return false;
+    }
+    const ViaIndexImage* end = images_ + header_->image_count;
+    const ViaIndexImage* it = std::lower_bound(images_, end, std::string_view(filename),
+                                               [this](const ViaIndexImage& image, std::string_view name) {
+                                                   return image_name(image, names_) < name;
+                                               });
+    bool found = false;
+    for (; it != end && image_name(*it, names_) == filename; ++it) {
+        append_polygons(*it, out);
+        found = true;
+    }
+    return found;
+}
+
+void ViaAnnotationIndex::append_polygons(const ViaIndexImage& image, std::vector<Polygon>& out) const {
+    for (uint32_t p = 0; p < image.polygon_count; ++p) {
+        const ViaIndexPolygon& polygon = polygons_[image.first_polygon + p];
+        Polygon poly;
+        poly.points.reserve(polygon.point_count);
+        const float* xy = points_ + polygon.first_point * 2;
+        for (uint32_t k = 0; k < polygon.point_count; ++k) {
+            poly.points.emplace_back(xy[2 * k], xy[2 * k + 1]);
+        }
+        out.push_back(poly);
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef VIA_INDEX_HPP
+#define VIA_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "semcv.hpp"
+#include "via_annotations.hpp"
+
+// Двоичный индекс разметки VIA: имя файла -> многоугольники. Строится один раз потоковым
+// разбором points.json (без DOM), дальше запросы идут по отображённому в память файлу индекса,
+// так что время запуска и память не зависят от размера разметки.
+//
+// Формат (порядок байт машины): ViaIndexHeader, координаты точек (пары float),
+// таблица многоугольников, таблица изображений по возрастанию имени, блок имён.
+const uint32_t VIA_INDEX_VERSION = 1;
+
+struct ViaIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t source_size;  // размер и mtime points.json, по которым индекс был построен
+    int64_t source_mtime;
+    uint64_t image_count;
+    uint64_t polygon_count;
+    uint64_t point_count;
+    uint64_t points_offset;
+    uint64_t polygons_offset;
+    uint64_t images_offset;
+    uint64_t names_offset;
+    uint64_t names_size;
+};
+
+struct ViaIndexPolygon {
+    uint64_t first_point;
+    uint32_t point_count;
+    uint32_t reserved;
+};
+
+struct ViaIndexImage {
+    uint64_t name_offset;
+    uint32_t name_size;
+    uint32_t polygon_count;
+    uint64_t first_polygon;
+};
+
+// Потоковый разбор json_path (nlohmann::json::sax_parse) в индекс index_path.
+// Берутся только многоугольники (shape_attributes.name == "polygon"), остальные фигуры пропускаются.
+bool build_via_index(const std::string& json_path, const std::string& index_path);
+
+class ViaAnnotationIndex {
+public:
+    // Открывает index_path (по умолчанию json_path + ".idx"); если его нет или points.json
+    // с тех пор изменился, сначала перестраивает.
+    bool open(const std::string& json_path, const std::string& index_path = "");
+
+    size_t size() const {
+        return header_ != nullptr ? static_cast<size_t>(header_->image_count) : 0;
+    }
+    // Изображения по возрастанию имени
+    std::string filename(size_t i) const;
+    void polygons(size_t i, std::vector<Polygon>& out) const;
+    // Многоугольники всех записей с этим именем; false - имени нет в разметке
+    bool find(const std::string& filename, std::vector<Polygon>& out) const;
+
+private:
+    bool attach();
+    void append_polygons(const ViaIndexImage& image, std::vector<Polygon>& out) const;
+
+    semcv::MappedFile file_;
+    const ViaIndexHeader* header_ = nullptr;
+    const float* points_ = nullptr;
+    const ViaIndexPolygon* polygons_ = nullptr;
+    const ViaIndexImage* images_ = nullptr;
+    const char* names_ = nullptr;
+};
+
+#endif // VIA_INDEX_HPP
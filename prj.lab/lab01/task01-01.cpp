@@ -12,8 +12,12 @@ int main(int argc, char** argv) {
     std::filesystem::path lst_path(argv[1]);
     auto file_paths = semcv::get_list_of_file_paths(lst_path);
 
-    for (const auto& file_path : file_paths) {
-        cv::Mat img = cv::imread(file_path.string(), cv::IMREAD_UNCHANGED);
+    for (size_t i = 0; i < file_paths.size(); ++i) {
+        const auto& file_path = file_paths[i];
+        if (i + 1 < file_paths.size()) {
+            semcv::prefetch_file(file_paths[i + 1]);
+        }
+        cv::Mat img = semcv::imread_mapped(file_path, cv::IMREAD_UNCHANGED);
         if (img.empty()) {
             std::cerr << "Could not read image: " << file_path << std::endl;
             continue;
@@ -31,6 +31,26 @@ void save_statistics_to_csv(const std::string& filename, const std::vector<std::
     std::cout << "Statistics saved to: " << filename << std::endl;
 }
 
+// Карта областей gen_tgtimg00, строится один раз на все изображения этого размера.
+// Области как у прежних масок: Square - весь прямоугольник вместе с кругом, Background - всё вне его.
+// Метки: 0 - фон, 1 - квадрат без круга, 2 - круг; Square собирается из 1 и 2.
+cv::Mat make_region_labels(cv::Size size) {
+    cv::Mat labels = cv::Mat::zeros(size, CV_8UC1);
+    cv::rectangle(labels, cv::Point(23, 23), cv::Point(232, 232), cv::Scalar(1), -1);
+    cv::circle(labels, cv::Point(128, 128), 83, cv::Scalar(2), -1);
+    return labels;
+}
+
+void append_region_statistics(std::vector<std::vector<std::string>>& data, const std::string& image_label,
+                              const cv::Mat& img, const cv::Mat& labels) {
+    std::vector<semcv::RegionStats> stats = semcv::region_stats(img, labels, 3);
+    const semcv::RegionStats square = semcv::merge_region_stats(stats[1], stats[2]);
+
+    data.push_back({ image_label, "Background", std::to_string(stats[0].mean), std::to_string(stats[0].stddev) });
+    data.push_back({ image_label, "Square", std::to_string(square.mean), std::to_string(square.stddev) });
+    data.push_back({ image_label, "Circle", std::to_string(stats[2].mean), std::to_string(stats[2].stddev) });
+}
+
 int main(int argc, char* argv[]) {
     std::string output_path = "output_collage.png";
     std::string hist_output_path = "output_histogram.png";
@@ -108,56 +128,18 @@ int main(int argc, char* argv[]) {
     }
 
     std::vector<std::vector<std::string>> stats_data;
+    const cv::Mat labels = make_region_labels(original_imgs[0].size());
 
     for (size_t img_idx = 0; img_idx < original_imgs.size(); ++img_idx) {
-        const cv::Mat& img = original_imgs[img_idx];
-
-        cv::Mat mask_background = cv::Mat::zeros(img.size(), CV_8UC1);
-        cv::Mat mask_square = cv::Mat::zeros(img.size(), CV_8UC1);
-        cv::Mat mask_circle = cv::Mat::zeros(img.size(), CV_8UC1);
-
-        cv::rectangle(mask_square, cv::Point(23, 23), cv::Point(232, 232), cv::Scalar(255), -1);
-        cv::circle(mask_circle, cv::Point(128, 128), 83, cv::Scalar(255), -1);
-        mask_background = 255 - (mask_square + mask_circle);
-
-        double mean_background, stddev_background;
-        double mean_square, stddev_square;
-        double mean_circle, stddev_circle;
-
-        semcv::calculate_distribution_params(img, mask_background, mean_background, stddev_background);
-        semcv::calculate_distribution_params(img, mask_square, mean_square, stddev_square);
-        semcv::calculate_distribution_params(img, mask_circle, mean_circle, stddev_circle);
-
         std::string image_label = "Image " + std::to_string(img_idx + 1);
-        stats_data.push_back({ image_label, "Background", std::to_string(mean_background), std::to_string(stddev_background) });
-        stats_data.push_back({ image_label, "Square", std::to_string(mean_square), std::to_string(stddev_square) });
-        stats_data.push_back({ image_label, "Circle", std::to_string(mean_circle), std::to_string(stddev_circle) });
+        append_region_statistics(stats_data, image_label, original_imgs[img_idx], labels);
     }
 
     for (size_t noise_idx = 0; noise_idx < noise_levels.size(); ++noise_idx) {
         for (size_t img_idx = 0; img_idx < original_imgs.size(); ++img_idx) {
             cv::Mat noisy_img = semcv::add_noise_gau(original_imgs[img_idx], noise_levels[noise_idx]);
-
-            cv::Mat mask_background = cv::Mat::zeros(noisy_img.size(), CV_8UC1);
-            cv::Mat mask_square = cv::Mat::zeros(noisy_img.size(), CV_8UC1);
-            cv::Mat mask_circle = cv::Mat::zeros(noisy_img.size(), CV_8UC1);
-
-            cv::rectangle(mask_square, cv::Point(23, 23), cv::Point(232, 232), cv::Scalar(255), -1);
-            cv::circle(mask_circle, cv::Point(128, 128), 83, cv::Scalar(255), -1);
-            mask_background = 255 - (mask_square + mask_circle);
-
-            double mean_background, stddev_background;
-            double mean_square, stddev_square;
-            double mean_circle, stddev_circle;
-
-            semcv::calculate_distribution_params(noisy_img, mask_background, mean_background, stddev_background);
-            semcv::calculate_distribution_params(noisy_img, mask_square, mean_square, stddev_square);
-            semcv::calculate_distribution_params(noisy_img, mask_circle, mean_circle, stddev_circle);
-
             std::string image_label = "Noisy Image " + std::to_string(img_idx + 1) + " (std=" + std::to_string(noise_levels[noise_idx]) + ")";
-            stats_data.push_back({ image_label, "Background", std::to_string(mean_background), std::to_string(stddev_background) });
-            stats_data.push_back({ image_label, "Square", std::to_string(mean_square), std::to_string(stddev_square) });
-            stats_data.push_back({ image_label, "Circle", std::to_string(mean_circle), std::to_string(stddev_circle) });
+            append_region_statistics(stats_data, image_label, noisy_img, labels);
         }
     }
 
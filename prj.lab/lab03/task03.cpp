@@ -1,19 +1,17 @@
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <filesystem>
+#include "../semcv/semcv.hpp"
 
 namespace fs = std::filesystem;
 
 cv::Mat createSingleHistogram(const cv::Mat& channel, const cv::Scalar& color) {
-    const int histSize = 256;
-    const float range[] = { 0, 256 };
-    const float* histRange = { range };
-    cv::Mat hist;
+    const int histSize = semcv::Histogram::BINS;
 
     int hist_w = 512, hist_h = 200;
     cv::Mat histImage(hist_h, hist_w, CV_8UC3, cv::Scalar(240, 240, 240));
 
-    cv::calcHist(&channel, 1, 0, cv::Mat(), hist, 1, &histSize, &histRange);
+    cv::Mat hist = semcv::Histogram(channel).to_mat();
     cv::normalize(hist, hist, 0, histImage.rows, cv::NORM_MINMAX, -1, cv::Mat());
 
     int bin_w = cvRound((double)hist_w / histSize);
@@ -79,32 +77,55 @@ void saveHistogramCollage(const cv::Mat& original, const cv::Mat& processed,
     }
 }
 
+// Пороги лабораторной считаются по прежним правилам (сравнения в double, как при переборе calcHist),
+// но без перебора всех уровней: CDF::quantile двоичным поиском даёт уровень, на котором правило
+// срабатывает с точностью до округления, а точный ответ - в шаге-двух от него.
+
+// Наименьший уровень, где выполнено монотонное (ложь..., истина...) условие reached; BINS - нигде
+template <typename Pred>
+int first_level(const semcv::CDF& cdf, double q, Pred reached) {
+    int level = std::min(std::max(cdf.quantile(q), 0), semcv::Histogram::BINS - 1);
+    while (level > 0 && reached(level - 1)) {
+        --level;
+    }
+    while (level < semcv::Histogram::BINS && !reached(level)) {
+        ++level;
+    }
+    return level;
+}
+
+// Наибольший уровень, где выполнено монотонное (истина..., ложь...) условие holds; -1 - нигде
+template <typename Pred>
+int last_level(const semcv::CDF& cdf, double q, Pred holds) {
+    int level = std::min(std::max(cdf.quantile(q), 0), semcv::Histogram::BINS - 1);
+    while (level < semcv::Histogram::BINS - 1 && holds(level + 1)) {
+        ++level;
+    }
+    while (level >= 0 && !holds(level)) {
+        --level;
+    }
+    return level;
+}
+
 cv::Mat autocontrast(const cv::Mat& img, double q_black, double q_white) {
     CV_Assert(img.type() == CV_8UC1);
 
-    int histSize = 256;
-    float range[] = { 0, 256 };
-    const float* histRange = { range };
-    cv::Mat hist;
-    cv::calcHist(&img, 1, 0, cv::Mat(), hist, 1, &histSize, &histRange);
-
-    double total_pixels = img.rows * img.cols;
+    semcv::CDF cdf(img);
+    double total_pixels = static_cast<double>(cdf.total());
     double black_threshold = q_black * total_pixels;
     double white_threshold = (1.0 - q_white) * total_pixels;
 
-    int black_level = 0;
-    int white_level = 255;
+    // Прежний перебор: уровни 0..white, black_level ставится при первом rank >= black_threshold,
+    // пока он равен 0. Поэтому порог, достигнутый уже на уровне 0, даёт black_level = 1
+    // (если перебор дошёл до уровня 1), а недостигнутый до white - 0.
+    int black = first_level(cdf, q_black, [&](int i) { return cdf.rank(i) >= black_threshold; });
+    int white = first_level(cdf, 1.0 - q_white, [&](int i) { return cdf.rank(i) >= white_threshold; });
+    const int last = white < semcv::Histogram::BINS ? white : semcv::Histogram::BINS - 1;
 
-    double sum = 0;
-    for (int i = 0; i < histSize; ++i) {
-        sum += hist.at<float>(i);
-        if (sum >= black_threshold && black_level == 0) {
-            black_level = i;
-        }
-        if (sum >= white_threshold) {
-            white_level = i;
-            break;
-        }
+    int black_level = 0;
+    int white_level = white < semcv::Histogram::BINS ? white : 255;
+    if (black <= last) {
+        black_level = (black == 0 && last >= 1) ? 1 : black;
     }
 
     cv::Mat result;
@@ -164,32 +185,20 @@ cv::Mat autocontrast_rgb(const cv::Mat& img, double blackQuantile, double whiteQ
     cv::Mat gray;
     cv::cvtColor(img, gray, cv::COLOR_BGR2GRAY);
 
-    int histSize = 256;
-    float range[] = { 0, 256 };
-    const float* histRange = { range };
-    cv::Mat hist;
-    cv::calcHist(&gray, 1, 0, cv::Mat(), hist, 1, &histSize, &histRange);
-
-    double totalPixels = gray.rows * gray.cols;
-    int minThreshold = 0;
-    int maxThreshold = 255;
+    semcv::CDF cdf(gray);
+    double totalPixels = static_cast<double>(cdf.total());
 
-    double sum = 0;
-    for (int i = 0; i < 256; ++i) {
-        sum += hist.at<float>(i);
-        if (sum / totalPixels > blackQuantile) {
-            minThreshold = i;
-            break;
-        }
+    // Первый уровень, где доля пикселей <= него больше blackQuantile, и последний, где доля
+    // пикселей >= него больше whiteQuantile; не нашлось - 0 и 255
+    int minThreshold = first_level(cdf, blackQuantile, [&](int i) { return cdf.rank(i) / totalPixels > blackQuantile; });
+    if (minThreshold == semcv::Histogram::BINS) {
+        minThreshold = 0;
     }
-
-    sum = 0;
-    for (int i = 255; i >= 0; --i) {
-        sum += hist.at<float>(i);
-        if (sum / totalPixels > whiteQuantile) {
-            maxThreshold = i;
-            break;
-        }
+    int maxThreshold = last_level(cdf, 1.0 - whiteQuantile, [&](int i) {
+        return (cdf.total() - cdf.rank(i - 1)) / totalPixels > whiteQuantile;
+    });
+    if (maxThreshold < 0) {
+        maxThreshold = 255;
     }
 
     if (minThreshold >= maxThreshold) {
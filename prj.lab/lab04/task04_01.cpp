@@ -4,6 +4,7 @@
 #include <filesystem>
 #include <fstream>
 #include <nlohmann/json.hpp>
+#include "../semcv/semcv.hpp"
 
 using json = nlohmann::json;
 
@@ -73,9 +74,8 @@ cv::Mat generateCollage(const Config& config, std::vector<EllipseParameters>& al
 
             cv::GaussianBlur(singleImage, singleImage, cv::Size(config.blur_size, config.blur_size), 0);
 
-            cv::Mat noise(singleImage.size(), CV_8UC1);
-            cv::randn(noise, 0, config.noise_std);
-            singleImage = cv::max(cv::min(singleImage + noise, 255), 0);
+            uint64_t noiseSeed = (static_cast<uint64_t>(static_cast<uint32_t>(config.seed)) << 32) | static_cast<uint32_t>(row * config.n + col);
+            semcv::add_noise_gau(singleImage, singleImage, config.noise_std, noiseSeed);
 
             cv::Rect roi(col * singleImageSize, row * singleImageSize, singleImageSize, singleImageSize);
             singleImage.copyTo(collage(roi));
@@ -2,6 +2,7 @@
 #include <iostream>
 #include <fstream>
 #include <nlohmann/json.hpp>
+#include "../semcv/semcv.hpp"
 #include <vector>
 #include <algorithm>
 
@@ -31,7 +32,7 @@ std::vector<DetectedEllipse> detectEllipses(const cv::Mat& src) {
 
     cv::Mat morph;
     cv::Mat kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(5, 5));
-    cv::morphologyEx(binary, morph, cv::MORPH_CLOSE, kernel);
+    semcv::morphology_ex(binary, morph, cv::MORPH_CLOSE, kernel);
 
     std::vector<std::vector<cv::Point>> contours;
     cv::findContours(morph, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
@@ -75,7 +76,7 @@ int main(int argc, char** argv) {
     }
 
     try {
-        cv::Mat image = cv::imread(argv[1], cv::IMREAD_GRAYSCALE);
+        cv::Mat image = semcv::imread_mapped(argv[1], cv::IMREAD_GRAYSCALE);
         if (image.empty()) {
             throw std::runtime_error("Could not read input image");
         }
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <filesystem>
 #include <cmath>
+#include "../semcv/semcv.hpp"
 
 struct DetectedObject {
     float angle;
@@ -49,7 +50,7 @@ std::vector<cv::KeyPoint> detectBlobs(const cv::Mat& img) {
     cv::Mat processed;
     cv::GaussianBlur(img, processed, cv::Size(9, 9), 0);
     cv::normalize(processed, processed, 0, 255, cv::NORM_MINMAX, CV_32F);
-    cv::morphologyEx(processed, processed, cv::MORPH_OPEN, cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(5, 5)));
+    semcv::morphology_ex(processed, processed, cv::MORPH_OPEN, cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(5, 5)));
 
     std::vector<cv::KeyPoint> keypoints;
     const int num_levels = 3;
@@ -87,7 +88,8 @@ std::vector<cv::KeyPoint> detectBlobs(const cv::Mat& img) {
                 cv::absdiff(dog, cv::Scalar(0), dog_abs);
 
                 cv::Mat dilated;
-                cv::dilate(dog_abs, dilated, cv::Mat(), cv::Point(-1, -1), 1, cv::BORDER_REPLICATE);
+                // Для max-фильтра BORDER_REPLICATE даёт тот же результат, что и нейтральная граница semcv
+                semcv::dilate_rect(dog_abs, dilated, cv::Size(3, 3));
                 cv::Mat local_max = (dog_abs >= dilated) & (dog_abs > min_response);
 
                 std::vector<cv::Point> points;
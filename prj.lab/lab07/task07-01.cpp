@@ -5,6 +5,7 @@
 #include <filesystem>
 #include <fstream>
 #include <nlohmann/json.hpp>
+#include "../semcv/semcv.hpp"
 
 namespace fs = std::filesystem;
 using json = nlohmann::json;
@@ -40,7 +41,7 @@ std::vector<DetectedEllipse> detectEllipses(const cv::Mat& src) {
 
     cv::Mat morph;
     cv::Mat kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(5, 5));
-    cv::morphologyEx(binary, morph, cv::MORPH_CLOSE, kernel);
+    semcv::morphology_ex(binary, morph, cv::MORPH_CLOSE, kernel);
 
     std::vector<std::vector<cv::Point>> contours;
     cv::findContours(morph, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
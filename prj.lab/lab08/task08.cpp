@@ -3,6 +3,7 @@
 #include <vector>
 #include <fstream>
 #include <cmath>
+#include "../semcv/semcv.hpp"
 
 cv::Mat grayWorld(const cv::Mat& image) {
     cv::Mat result;
@@ -48,16 +49,12 @@ cv::Mat colorCorrection(const cv::Mat& image) {
 }
 
 cv::Mat visualizeColorDistribution(const cv::Mat& image) {
-    std::vector<cv::Mat> bgrChannels;
-    cv::split(image, bgrChannels);
-    int histSize = 256;
-    float range[] = { 0, 256 };
-    const float* histRange = { range };
+    int histSize = semcv::Histogram::BINS;
 
-    cv::Mat bHist, gHist, rHist;
-    cv::calcHist(&bgrChannels[0], 1, 0, cv::Mat(), bHist, 1, &histSize, &histRange);
-    cv::calcHist(&bgrChannels[1], 1, 0, cv::Mat(), gHist, 1, &histSize, &histRange);
-    cv::calcHist(&bgrChannels[2], 1, 0, cv::Mat(), rHist, 1, &histSize, &histRange);
+    semcv::Histogram hist(image);
+    cv::Mat bHist = hist.to_mat(0);
+    cv::Mat gHist = hist.to_mat(1);
+    cv::Mat rHist = hist.to_mat(2);
 
     int histWidth = 512, histHeight = 400;
     int binWidth = cvRound((double)histWidth / histSize);
@@ -176,16 +173,10 @@ void saveQualityParameters(const std::string& imagePath, const cv::Mat& original
     outFile.close();
 }
 
-void processImage(const std::string& path) {
+void processImage(const std::string& path, const cv::Mat& img) {
     const std::string resultDir = "/Users/mtrufmanov/MisisProject/misis2025s-22-01-trufmanov-m-a/prj.lab/result_images";
     const std::string histDir = "/Users/mtrufmanov/MisisProject/misis2025s-22-01-trufmanov-m-a/prj.lab/histograms";
 
-    cv::Mat img = cv::imread(path);
-    if (img.empty()) {
-        std::cerr << "Could not open image: " << path << std::endl;
-        return;
-    }
-
     cv::Mat grayWorldImg = grayWorld(img);
     cv::Mat correctedImg = colorCorrection(img);
 
@@ -208,16 +199,27 @@ void processImage(const std::string& path) {
     saveQualityParameters(path, img);
 }
 
+void processImage(const std::string& path) {
+    cv::Mat img = semcv::imread_mapped(path);
+    if (img.empty()) {
+        std::cerr << "Could not open image: " << path << std::endl;
+        return;
+    }
+    processImage(path, img);
+}
+
 void processImagePair(const std::string& path1, const std::string& path2) {
-    cv::Mat img1 = cv::imread(path1);
-    cv::Mat img2 = cv::imread(path2);
+    semcv::prefetch_file(path2);
+    cv::Mat img1 = semcv::imread_mapped(path1);
+    cv::Mat original2 = semcv::imread_mapped(path2);
 
-    if (img1.empty() || img2.empty()) {
+    if (img1.empty() || original2.empty()) {
         std::cerr << "Could not open images: " << path1 << " or " << path2 << std::endl;
         return;
     }
 
-    cv::resize(img2, img2, img1.size());
+    cv::Mat img2;
+    cv::resize(original2, img2, img1.size());
 
     double origMSE = calculateMSE(img1, img2);
     double origPSNR = calculatePSNR(img1, img2);
@@ -243,8 +245,8 @@ void processImagePair(const std::string& path1, const std::string& path2) {
     std::cout << "After CLAHE Correction:" << std::endl;
     std::cout << "  MSE: " << corrMSE << " | PSNR: " << corrPSNR << " dB | SSIM: " << corrSSIM << std::endl;
 
-    processImage(path1);
-    processImage(path2);
+    processImage(path1, img1);
+    processImage(path2, original2);
 }
 
 int main(int argc, char** argv) {
@@ -0,0 +1,18 @@
+#ifndef SEMCV_BENCH_UTIL_HPP
+#define SEMCV_BENCH_UTIL_HPP
+
+#include <chrono>
+
+// Общее для бенчмарков semcv: среднее время одного вызова f в мс.
+// Первый вызов - прогрев (кеши, ленивые LUT, пул потоков OpenCV), в замер не входит.
+template <typename F>
+double time_ms(int iterations, F&& f) {
+    f();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        f();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+#endif // SEMCV_BENCH_UTIL_HPP
@@ -0,0 +1,59 @@
+#include "semcv.hpp"
+#include "bench_util.hpp"
+#include <opencv2/opencv.hpp>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+// Пропускная способность gamma_correction и autocontrast по глубинам CV_8U, CV_16U, CV_32F.
+// Usage: semcv_depth_bench [width height] [iterations]
+
+double max_relative_error(const cv::Mat& src, const cv::Mat& result, double gamma) {
+    double worst = 0.0;
+    for (int y = 0; y < src.rows; ++y) {
+        const float* s = src.ptr<float>(y);
+        const float* r = result.ptr<float>(y);
+        for (int x = 0; x < src.cols; ++x) {
+            double expected = std::pow(static_cast<double>(s[x]), gamma);
+            if (expected > 1e-30) {
+                worst = std::max(worst, std::abs(r[x] - expected) / expected);
+            }
+        }
+    }
+    return worst;
+}
+
+void bench(const std::string& name, const cv::Mat& img, int iterations) {
+    const double gamma = 2.2;
+    const double mpix = img.total() / 1e6;
+    double gamma_ms = time_ms(iterations, [&]() { semcv::gamma_correction(img, gamma); });
+    double contrast_ms = time_ms(iterations, [&]() { semcv::autocontrast(img, 0.05, 0.95); });
+    std::cout << "  " << name << ": gamma " << gamma_ms << " ms (" << mpix / gamma_ms * 1000.0 << " Mpix/s)"
+              << ", autocontrast " << contrast_ms << " ms (" << mpix / contrast_ms * 1000.0 << " Mpix/s)";
+    if (img.depth() == CV_32F) {
+        std::cout << ", gamma max rel. error " << max_relative_error(img, semcv::gamma_correction(img, gamma), gamma);
+    }
+    std::cout << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int width = argc > 2 ? std::stoi(argv[1]) : 4000;
+    int height = argc > 2 ? std::stoi(argv[2]) : 3000;
+    int iterations = argc > 3 ? std::stoi(argv[3]) : 10;
+
+    cv::Mat img8(height, width, CV_8UC1);
+    cv::randu(img8, cv::Scalar(0), cv::Scalar(256));
+    cv::Mat img16(height, width, CV_16UC1);
+    cv::randu(img16, cv::Scalar(0), cv::Scalar(65536));
+    cv::Mat img32(height, width, CV_32FC1);
+    cv::randu(img32, cv::Scalar(0), cv::Scalar(1));
+
+    for (int threads : { cv::getNumThreads(), 1 }) {
+        cv::setNumThreads(threads);
+        std::cout << width << "x" << height << ", OpenCV threads: " << threads << std::endl;
+        bench("CV_8U", img8, iterations);
+        bench("CV_16U", img16, iterations);
+        bench("CV_32F", img32, iterations);
+    }
+    return 0;
+}
@@ -0,0 +1,201 @@
+#include "semcv.hpp"
+#include "lut_cache.hpp"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace semcv {
+
+    static const int LEVELS_16U = 65536;
+    // Корзин гистограммы CV_32F между минимумом и максимумом кадра
+    static const int BUCKETS_32F = 65536;
+    // Минимум элементов на блок строк для cv::parallel_for_
+    static const size_t DEPTH_MIN_BLOCK_ELEMENTS = 1 << 15;
+    // Таблица CV_16U занимает 128 КБ, в кеше - последние 4 значения gamma
+    static const size_t GAMMA_LUT_16U_CACHE_SIZE = 4;
+
+    // Число блоков строк: не больше потоков OpenCV и не меньше DEPTH_MIN_BLOCK_ELEMENTS элементов на блок
+    static int row_blocks(const cv::Mat& img) {
+        size_t row_elements = std::max<size_t>(static_cast<size_t>(img.cols) * img.channels(), 1);
+        int min_rows = static_cast<int>(std::max<size_t>(1, DEPTH_MIN_BLOCK_ELEMENTS / row_elements));
+        int blocks = std::min(cv::getNumThreads(), (img.rows + min_rows - 1) / min_rows);
+        return std::max(1, std::min(blocks, img.rows));
+    }
+
+    // f(src_row, dst_row, row_elements) по блокам строк параллельно
+    template <typename Src, typename Dst, typename F>
+    static void for_each_row(const cv::Mat& src, cv::Mat& dst, F&& f) {
+        const int blocks = row_blocks(src);
+        const int row_elements = src.cols * src.channels();
+        cv::parallel_for_(cv::Range(0, blocks), [&](const cv::Range& range) {
+            for (int b = range.start; b < range.end; ++b) {
+                int row_begin = static_cast<int>(static_cast<int64_t>(src.rows) * b / blocks);
+                int row_end = static_cast<int>(static_cast<int64_t>(src.rows) * (b + 1) / blocks);
+                for (int y = row_begin; y < row_end; ++y) {
+                    f(src.ptr<Src>(y), dst.ptr<Dst>(y), row_elements);
+                }
+            }
+        });
+    }
+
+    // LUT гаммы на 65536 уровней, кешируется по значению gamma, как gamma_lut();
+    // таблица живёт, пока жив возвращённый указатель, даже если кеш её уже вытеснил
+    static std::shared_ptr<const std::vector<ushort>> gamma_lut_16u(double gamma) {
+        static LutCache<std::vector<ushort>> cache(GAMMA_LUT_16U_CACHE_SIZE);
+
+        return cache.get(gamma, [](double g) {
+            std::vector<ushort> lut(LEVELS_16U);
+            for (int i = 0; i < LEVELS_16U; ++i) {
+                lut[i] = cv::saturate_cast<ushort>(pow(i / 65535.0, g) * 65535.0);
+            }
+            return lut;
+        });
+    }
+
+    static void apply_lut_16u(const cv::Mat& img, cv::Mat& dst, const ushort* lut) {
+        for_each_row<ushort, ushort>(img, dst, [lut](const ushort* s, ushort* d, int n) {
+            for (int x = 0; x < n; ++x) {
+                d[x] = lut[s[x]];
+            }
+        });
+    }
+
+    cv::Mat gamma_correction_deep(const cv::Mat& img, double gamma) {
+        CV_Assert(img.depth() == CV_16U || img.depth() == CV_32F);
+
+        cv::Mat res(img.size(), img.type());
+        if (img.depth() == CV_16U) {
+            std::shared_ptr<const std::vector<ushort>> lut = gamma_lut_16u(gamma);
+            apply_lut_16u(img, res, lut->data());
+        } else {
+            // cv::pow на CV_32F идёт через векторизованные log/exp OpenCV (относительная ошибка
+            // порядка 1e-6); отрицательные значения сначала обнуляются, иначе pow взял бы модуль
+            for_each_row<float, float>(img, res, [gamma](const float* s, float* d, int n) {
+                cv::Mat src_row(1, n, CV_32F, const_cast<float*>(s));
+                cv::Mat dst_row(1, n, CV_32F, d);
+                cv::max(src_row, 0.0, dst_row);
+                cv::pow(dst_row, gamma, dst_row);
+            });
+        }
+        return res;
+    }
+
+    // Гистограмма по блокам строк: у каждого блока свои 32-битные счётчики, затем сложение.
+    // Как в histogram.cpp, блок не длиннее, чем помещается в uint32_t. bin(value) -> номер корзины в [0, bins).
+    template <typename T, typename Bin>
+    static std::vector<uint64_t> histogram_deep(const cv::Mat& img, int bins, Bin bin) {
+        const size_t max_block_rows = std::max<size_t>(1,
+            std::numeric_limits<uint32_t>::max() / std::max<size_t>(static_cast<size_t>(img.cols), 1));
+        int blocks = std::max(row_blocks(img),
+            static_cast<int>((static_cast<size_t>(img.rows) + max_block_rows - 1) / max_block_rows));
+        blocks = std::max(1, std::min(blocks, img.rows));
+        std::vector<uint32_t> partial(static_cast<size_t>(bins) * blocks, 0);
+        cv::parallel_for_(cv::Range(0, blocks), [&](const cv::Range& range) {
+            for (int b = range.start; b < range.end; ++b) {
+                uint32_t* hist = partial.data() + static_cast<size_t>(bins) * b;
+                int row_begin = static_cast<int>(static_cast<int64_t>(img.rows) * b / blocks);
+                int row_end = static_cast<int>(static_cast<int64_t>(img.rows) * (b + 1) / blocks);
+                for (int y = row_begin; y < row_end; ++y) {
+                    const T* p = img.ptr<T>(y);
+                    for (int x = 0; x < img.cols; ++x) {
+                        ++hist[bin(p[x])];
+                    }
+                }
+            }
+        });
+
+        std::vector<uint64_t> counts(bins, 0);
+        for (int b = 0; b < blocks; ++b) {
+            const uint32_t* hist = partial.data() + static_cast<size_t>(bins) * b;
+            for (int v = 0; v < bins; ++v) {
+                counts[v] += hist[v];
+            }
+        }
+        return counts;
+    }
+
+    // Наименьшая корзина, до которой включительно набирается ceil(q * n) элементов (как CDF::quantile).
+    // fraction - доля этих элементов, взятая из самой корзины, для интерполяции внутри неё.
+    static int quantile_bin(const std::vector<uint64_t>& prefix, double q, double& fraction) {
+        const uint64_t n = prefix.back();
+        double threshold = std::ceil(std::min(std::max(q, 0.0), 1.0) * n);
+        uint64_t need = std::max<uint64_t>(1, std::min<uint64_t>(n, static_cast<uint64_t>(threshold)));
+        int bin = static_cast<int>(std::lower_bound(prefix.begin(), prefix.end(), need) - prefix.begin());
+        uint64_t before = bin > 0 ? prefix[bin - 1] : 0;
+        fraction = static_cast<double>(need - before) / static_cast<double>(prefix[bin] - before);
+        return bin;
+    }
+
+    static std::vector<uint64_t> prefix_sums(std::vector<uint64_t> counts) {
+        for (size_t v = 1; v < counts.size(); ++v) {
+            counts[v] += counts[v - 1];
+        }
+        return counts;
+    }
+
+    cv::Mat autocontrast_deep(const cv::Mat& img, double q_black, double q_white) {
+        CV_Assert(img.type() == CV_16UC1 || img.type() == CV_32FC1);
+
+        cv::Mat result(img.size(), img.type());
+        if (img.empty()) {
+            return result;
+        }
+        double fraction = 0.0;
+
+        if (img.depth() == CV_16U) {
+            std::vector<uint64_t> prefix = prefix_sums(histogram_deep<ushort>(img, LEVELS_16U, [](ushort v) { return v; }));
+            int black_level = quantile_bin(prefix, q_black, fraction);
+            int white_level = quantile_bin(prefix, q_white, fraction);
+
+            std::vector<ushort> lut(LEVELS_16U);
+            for (int i = 0; i < LEVELS_16U; ++i) {
+                if (i <= black_level) {
+                    lut[i] = 0;
+                }
+                else if (i >= white_level) {
+                    lut[i] = 65535;
+                }
+                else {
+                    lut[i] = cv::saturate_cast<ushort>(65535.0 * (i - black_level) / (white_level - black_level));
+                }
+            }
+            apply_lut_16u(img, result, lut.data());
+            return result;
+        }
+
+        // CV_32F: корзины равной ширины между минимумом и максимумом, уровень внутри корзины
+        // интерполируется, так что ошибка квантиля меньше ширины корзины
+        double min_value = 0.0, max_value = 0.0;
+        cv::minMaxLoc(img, &min_value, &max_value);
+        if (!(max_value > min_value)) {
+            result.setTo(cv::Scalar(0));
+            return result;
+        }
+        const float lo = static_cast<float>(min_value);
+        const float scale = static_cast<float>(BUCKETS_32F / (max_value - min_value));
+        std::vector<uint64_t> prefix = prefix_sums(histogram_deep<float>(img, BUCKETS_32F, [lo, scale](float v) {
+            int bin = static_cast<int>((v - lo) * scale);
+            return std::min(std::max(bin, 0), BUCKETS_32F - 1);
+        }));
+
+        int black_bin = quantile_bin(prefix, q_black, fraction);
+        const float black_level = lo + static_cast<float>((black_bin + fraction) / scale);
+        int white_bin = quantile_bin(prefix, q_white, fraction);
+        const float white_level = lo + static_cast<float>((white_bin + fraction) / scale);
+
+        const float range = white_level - black_level;
+        for_each_row<float, float>(img, result, [black_level, white_level, range](const float* s, float* d, int n) {
+            for (int x = 0; x < n; ++x) {
+                float v = s[x];
+                float stretched = range > 0.0f ? (v - black_level) / range : 0.0f;
+                stretched = std::min(std::max(stretched, 0.0f), 1.0f);
+                d[x] = v <= black_level ? 0.0f : (v >= white_level ? 1.0f : stretched);
+            }
+        });
+        return result;
+    }
+
+} // namespace semcv
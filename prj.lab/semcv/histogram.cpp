@@ -0,0 +1,196 @@
+#include "semcv.hpp"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace semcv {
+
+    // Минимум байт на блок строк: на меньших блоках накладные расходы потока и сведения больше самого счёта
+    static const size_t HISTOGRAM_MIN_BLOCK_BYTES = 1 << 16;
+
+    // SUB подгистограмм на канал: пиксели x, x + 1, ..., x + SUB - 1 пишут в разные таблицы,
+    // поэтому серия одинаковых значений не упирается в чтение только что записанной ячейки.
+    // sub - SUB * CN таблиц по 256 счётчиков, таблица подгистограммы s канала c - (s * CN + c).
+    template <int CN, int SUB>
+    static void accumulate_rows(const cv::Mat& img, int row_begin, int row_end, uint32_t* sub) {
+        const int cols = img.cols;
+        for (int y = row_begin; y < row_end; ++y) {
+            const uchar* p = img.ptr<uchar>(y);
+            int x = 0;
+            for (; x + SUB <= cols; x += SUB, p += SUB * CN) {
+                for (int s = 0; s < SUB; ++s) {
+                    for (int c = 0; c < CN; ++c) {
+                        ++sub[(s * CN + c) * Histogram::BINS + p[s * CN + c]];
+                    }
+                }
+            }
+            for (; x < cols; ++x, p += CN) {
+                for (int c = 0; c < CN; ++c) {
+                    ++sub[c * Histogram::BINS + p[c]];
+                }
+            }
+        }
+    }
+
+    // С маской: считаются пиксели, где mask != 0, подгистограммы не нужны - ветвление по маске дороже
+    template <int CN>
+    static void accumulate_rows_masked(const cv::Mat& img, const cv::Mat& mask, int row_begin, int row_end, uint32_t* sub) {
+        const int cols = img.cols;
+        for (int y = row_begin; y < row_end; ++y) {
+            const uchar* p = img.ptr<uchar>(y);
+            const uchar* m = mask.ptr<uchar>(y);
+            for (int x = 0; x < cols; ++x, p += CN) {
+                if (m[x] != 0) {
+                    for (int c = 0; c < CN; ++c) {
+                        ++sub[c * Histogram::BINS + p[c]];
+                    }
+                }
+            }
+        }
+    }
+
+    template <int CN, int SUB>
+    static void histogram_blocks(const cv::Mat& img, const cv::Mat& mask, std::vector<uint64_t>& counts) {
+        const size_t table = static_cast<size_t>(SUB) * CN * Histogram::BINS;
+        const size_t row_bytes = static_cast<size_t>(img.cols) * CN;
+
+        // Блок не длиннее, чем помещается в 32-битные счётчики, и не короче HISTOGRAM_MIN_BLOCK_BYTES
+        const size_t max_block_pixels = std::numeric_limits<uint32_t>::max();
+        int min_rows = static_cast<int>(std::max<size_t>(1, HISTOGRAM_MIN_BLOCK_BYTES / std::max<size_t>(row_bytes, 1)));
+        int blocks = std::max(1, std::min(cv::getNumThreads(), (img.rows + min_rows - 1) / min_rows));
+        size_t total_pixels = static_cast<size_t>(img.rows) * img.cols;
+        blocks = std::max<int>(blocks, static_cast<int>((total_pixels + max_block_pixels - 1) / max_block_pixels));
+        blocks = std::min(blocks, img.rows);
+
+        std::vector<uint32_t> partial(table * blocks, 0);
+        cv::parallel_for_(cv::Range(0, blocks), [&](const cv::Range& range) {
+            for (int b = range.start; b < range.end; ++b) {
+                int row_begin = static_cast<int>(static_cast<int64_t>(img.rows) * b / blocks);
+                int row_end = static_cast<int>(static_cast<int64_t>(img.rows) * (b + 1) / blocks);
+                if (mask.empty()) {
+                    accumulate_rows<CN, SUB>(img, row_begin, row_end, partial.data() + table * b);
+                } else {
+                    accumulate_rows_masked<CN>(img, mask, row_begin, row_end, partial.data() + table * b);
+                }
+            }
+        });
+
+        // Сведение: блоки и подгистограммы складываются в целых, так что результат не зависит
+        // от числа потоков и порядка их завершения
+        counts.assign(static_cast<size_t>(CN) * Histogram::BINS, 0);
+        for (int b = 0; b < blocks; ++b) {
+            const uint32_t* block = partial.data() + table * b;
+            for (int s = 0; s < SUB; ++s) {
+                for (int c = 0; c < CN; ++c) {
+                    const uint32_t* src = block + (s * CN + c) * Histogram::BINS;
+                    uint64_t* dst = counts.data() + c * Histogram::BINS;
+                    for (int v = 0; v < Histogram::BINS; ++v) {
+                        dst[v] += src[v];
+                    }
+                }
+            }
+        }
+    }
+
+    Histogram::Histogram(const cv::Mat& img, const cv::Mat& mask) {
+        compute(img, mask);
+    }
+
+    void Histogram::compute(const cv::Mat& img, const cv::Mat& mask) {
+        CV_Assert(img.depth() == CV_8U && img.channels() >= 1 && img.channels() <= 4);
+        CV_Assert(mask.empty() || (mask.type() == CV_8UC1 && mask.size() == img.size()));
+
+        channels_ = img.channels();
+        if (img.empty()) {
+            total_ = 0;
+            counts_.assign(static_cast<size_t>(channels_) * BINS, 0);
+            return;
+        }
+        switch (channels_) {
+        case 1:
+            histogram_blocks<1, 4>(img, mask, counts_);
+            break;
+        case 2:
+            histogram_blocks<2, 2>(img, mask, counts_);
+            break;
+        case 3:
+            histogram_blocks<3, 2>(img, mask, counts_);
+            break;
+        default:
+            histogram_blocks<4, 2>(img, mask, counts_);
+            break;
+        }
+        total_ = 0;
+        for (int v = 0; v < BINS; ++v) {
+            total_ += counts_[v];
+        }
+    }
+
+    cv::Mat Histogram::to_mat(int channel) const {
+        CV_Assert(channel >= 0 && channel < channels_);
+        cv::Mat hist(BINS, 1, CV_32F);
+        const uint64_t* src = counts(channel);
+        for (int v = 0; v < BINS; ++v) {
+            hist.at<float>(v) = static_cast<float>(src[v]);
+        }
+        return hist;
+    }
+
+    CDF::CDF(const Histogram& hist, int channel) {
+        CV_Assert(channel >= 0 && channel < hist.channels());
+        *this = CDF(hist.counts(channel));
+    }
+
+    CDF::CDF(const uint64_t* counts) {
+        for (int v = 0; v < Histogram::BINS; ++v) {
+            rank_[v + 1] = rank_[v] + counts[v];
+            sum_ += counts[v] * static_cast<uint64_t>(v);
+            sq_sum_ += counts[v] * static_cast<uint64_t>(v * v);
+        }
+    }
+
+    CDF::CDF(const cv::Mat& img, const cv::Mat& mask)
+        : CDF(Histogram(img, mask)) {
+        CV_Assert(img.channels() == 1);
+    }
+
+    uint64_t CDF::rank(int level) const {
+        if (level < 0) {
+            return 0;
+        }
+        return rank_[std::min(level, Histogram::BINS - 1) + 1];
+    }
+
+    double CDF::fraction(int level) const {
+        return total() > 0 ? static_cast<double>(rank(level)) / total() : 0.0;
+    }
+
+    int CDF::quantile(double q) const {
+        const uint64_t n = total();
+        if (n == 0) {
+            return -1;
+        }
+        double threshold = std::ceil(std::min(std::max(q, 0.0), 1.0) * n);
+        uint64_t need = std::max<uint64_t>(1, std::min<uint64_t>(n, static_cast<uint64_t>(threshold)));
+        // rank_ + 1 - неубывающие ранги уровней 0..255
+        const uint64_t* ranks = rank_ + 1;
+        return static_cast<int>(std::lower_bound(ranks, ranks + Histogram::BINS, need) - ranks);
+    }
+
+    double CDF::mean() const {
+        return total() > 0 ? static_cast<double>(sum_) / total() : 0.0;
+    }
+
+    double CDF::stddev() const {
+        if (total() == 0) {
+            return 0.0;
+        }
+        double m = mean();
+        double variance = static_cast<double>(sq_sum_) / total() - m * m;
+        return std::sqrt(std::max(variance, 0.0));
+    }
+
+} // namespace semcv
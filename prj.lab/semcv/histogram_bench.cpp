@@ -0,0 +1,82 @@
+#include "semcv.hpp"
+#include "bench_util.hpp"
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// semcv::Histogram против cv::calcHist: одноканальное изображение и BGR (calcHist - split и три вызова).
+// Usage: semcv_histogram_bench [image] [iterations]
+
+cv::Mat calc_hist(const cv::Mat& channel) {
+    const int histSize = 256;
+    const float range[] = { 0, 256 };
+    const float* histRange = { range };
+    cv::Mat hist;
+    cv::calcHist(&channel, 1, 0, cv::Mat(), hist, 1, &histSize, &histRange);
+    return hist;
+}
+
+bool same(const cv::Mat& a, const cv::Mat& b) {
+    return cv::norm(a, b, cv::NORM_INF) == 0.0;
+}
+
+void bench(const std::string& name, const cv::Mat& img, int iterations) {
+    std::vector<cv::Mat> reference;
+    double calc_ms = time_ms(iterations, [&]() {
+        std::vector<cv::Mat> channels;
+        cv::split(img, channels);
+        reference.clear();
+        for (const auto& channel : channels) {
+            reference.push_back(calc_hist(channel));
+        }
+    });
+
+    semcv::Histogram hist;
+    double semcv_ms = time_ms(iterations, [&]() {
+        hist.compute(img);
+    });
+
+    bool equal = true;
+    for (int c = 0; c < img.channels(); ++c) {
+        equal = equal && same(reference[c], hist.to_mat(c));
+    }
+    std::cout << name << " " << img.cols << "x" << img.rows << "x" << img.channels()
+              << ": calcHist " << calc_ms << " ms, semcv::Histogram " << semcv_ms << " ms"
+              << ", speedup " << calc_ms / semcv_ms
+              << (equal ? ", results equal" : ", RESULTS DIFFER") << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 2 ? std::stoi(argv[2]) : 50;
+
+    cv::Mat bgr;
+    if (argc > 1) {
+        bgr = cv::imread(argv[1], cv::IMREAD_COLOR);
+        if (bgr.empty()) {
+            std::cerr << "Failed to load image: " << argv[1] << std::endl;
+            return 1;
+        }
+    } else {
+        // Скан документа: в основном фон одного уровня, на нём шумный текст
+        bgr = cv::Mat(3000, 2000, CV_8UC3, cv::Scalar(235, 238, 240));
+        cv::Mat noise(bgr.size(), CV_8UC3);
+        cv::randu(noise, cv::Scalar::all(0), cv::Scalar::all(256));
+        noise.copyTo(bgr, noise > 230);
+    }
+    cv::Mat gray;
+    cv::cvtColor(bgr, gray, cv::COLOR_BGR2GRAY);
+    cv::Mat random(bgr.size(), CV_8UC1);
+    cv::randu(random, cv::Scalar(0), cv::Scalar(256));
+
+    std::cout << "OpenCV threads: " << cv::getNumThreads() << ", iterations: " << iterations << std::endl;
+    bench("gray", gray, iterations);
+    bench("uniform noise", random, iterations);
+    bench("bgr", bgr, iterations);
+
+    cv::setNumThreads(1);
+    std::cout << "OpenCV threads: 1" << std::endl;
+    bench("gray", gray, iterations);
+    bench("bgr", bgr, iterations);
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include "semcv.hpp"
+#include <opencv2/opencv.hpp>
+#include <fstream>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SEMCV_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace semcv {
+
+    MappedFile::MappedFile(const std::filesystem::path& path, ReadAdvice advice) {
+#ifdef SEMCV_HAVE_MMAP
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) {
+            return;
+        }
+        struct stat st;
+        if (::fstat(fd_, &st) != 0 || st.st_size <= 0) {
+            close();
+            return;
+        }
+        void* mapping = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (mapping == MAP_FAILED) {
+            close();
+            return;
+        }
+        data_ = static_cast<const uchar*>(mapping);
+        size_ = static_cast<size_t>(st.st_size);
+        mapped_ = true;
+
+        // Декодер читает файл целиком и от начала к концу
+        if (advice == ReadAdvice::Sequential) {
+            ::madvise(mapping, size_, MADV_SEQUENTIAL);
+            ::madvise(mapping, size_, MADV_WILLNEED);
+        } else if (advice == ReadAdvice::WillNeed) {
+            ::madvise(mapping, size_, MADV_WILLNEED);
+        }
+#else
+        (void)advice;
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) {
+            return;
+        }
+        std::streamsize size = file.tellg();
+        if (size <= 0) {
+            return;
+        }
+        fallback_.resize(static_cast<size_t>(size));
+        file.seekg(0);
+        if (!file.read(reinterpret_cast<char*>(fallback_.data()), size)) {
+            fallback_.clear();
+            return;
+        }
+        data_ = fallback_.data();
+        size_ = fallback_.size();
+#endif
+    }
+
+    MappedFile::~MappedFile() {
+        close();
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            close();
+            data_ = other.data_;
+            size_ = other.size_;
+            fd_ = other.fd_;
+            mapped_ = other.mapped_;
+            fallback_ = std::move(other.fallback_);
+            other.data_ = nullptr;
+            other.size_ = 0;
+            other.fd_ = -1;
+            other.mapped_ = false;
+        }
+        return *this;
+    }
+
+    cv::Mat MappedFile::mat() const {
+        if (!is_open()) {
+            return cv::Mat();
+        }
+        // imdecode только читает буфер, const_cast нужен лишь конструктору Mat
+        return cv::Mat(1, static_cast<int>(size_), CV_8UC1, const_cast<uchar*>(data_));
+    }
+
+    void MappedFile::close(bool drop_cache) {
+#ifdef SEMCV_HAVE_MMAP
+        if (mapped_) {
+            ::munmap(const_cast<uchar*>(data_), size_);
+        }
+        if (fd_ >= 0) {
+#ifdef POSIX_FADV_DONTNEED
+            // Страницы, которые ещё отображены, из кеша не уходят - поэтому сначала munmap
+            if (drop_cache) {
+                ::posix_fadvise(fd_, 0, 0, POSIX_FADV_DONTNEED);
+            }
+#endif
+            ::close(fd_);
+        }
+#endif
+        (void)drop_cache;
+        data_ = nullptr;
+        size_ = 0;
+        fd_ = -1;
+        mapped_ = false;
+        fallback_.clear();
+        fallback_.shrink_to_fit();
+    }
+
+    cv::Mat imread_mapped(const std::filesystem::path& path, int flags, bool drop_cache) {
+        MappedFile file(path);
+        if (!file.is_open()) {
+            return cv::Mat();
+        }
+        cv::Mat image = cv::imdecode(file.mat(), flags);
+        file.close(drop_cache);
+        return image;
+    }
+
+    void prefetch_file(const std::filesystem::path& path) {
+        // madvise(WILLNEED) запускает асинхронное чтение в page cache, которое продолжается и после munmap
+        MappedFile file(path, ReadAdvice::WillNeed);
+    }
+
+} // namespace semcv
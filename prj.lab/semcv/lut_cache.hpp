@@ -0,0 +1,47 @@
+#ifndef SEMCV_LUT_CACHE_HPP
+#define SEMCV_LUT_CACHE_HPP
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace semcv {
+
+    // Кеш таблиц по значению параметра (gamma) на capacity последних значений. При промахе
+    // вытесняется дольше всех не запрашиваемая таблица, так что перебор гамм не раздувает память.
+    // Таблицы неизменяемые и отдаются через shared_ptr: вытеснение не освобождает таблицу,
+    // с которой ещё работает другой поток.
+    template <typename Table>
+    class LutCache {
+    public:
+        explicit LutCache(size_t capacity) : capacity_(capacity) {}
+
+        // build(key) строит таблицу при промахе
+        template <typename Build>
+        std::shared_ptr<const Table> get(double key, Build&& build) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+                if (it->first == key) {
+                    entries_.splice(entries_.begin(), entries_, it);
+                    return it->second;
+                }
+            }
+            auto table = std::make_shared<const Table>(build(key));
+            entries_.emplace_front(key, table);
+            if (entries_.size() > capacity_) {
+                entries_.pop_back();
+            }
+            return table;
+        }
+
+    private:
+        size_t capacity_;
+        std::mutex mutex_;
+        std::list<std::pair<double, std::shared_ptr<const Table>>> entries_; // сначала недавние
+    };
+
+} // namespace semcv
+
+#endif // SEMCV_LUT_CACHE_HPP
@@ -0,0 +1,279 @@
+#include "semcv.hpp"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace semcv {
+
+    template <typename T>
+    struct MaxOp {
+        static T neutral() { return std::numeric_limits<T>::lowest(); }
+        T operator()(T a, T b) const { return a > b ? a : b; }
+    };
+
+    template <typename T>
+    struct MinOp {
+        static T neutral() { return std::numeric_limits<T>::max(); }
+        T operator()(T a, T b) const { return a < b ? a : b; }
+    };
+
+    // Общий для потока буфер под промежуточные строки, чтобы не выделять память на каждый вызов
+    template <typename T>
+    static T* scratch(size_t count) {
+        thread_local std::vector<unsigned char> buffer;
+        size_t bytes = count * sizeof(T);
+        if (buffer.size() < bytes) {
+            buffer.resize(bytes);
+        }
+        return reinterpret_cast<T*>(buffer.data());
+    }
+
+    // out[i] = op(e[i], ..., e[i + k - 1]), i < n, где e[t] = row[t + off] внутри [lo, hi) и neutral снаружи.
+    // van Herk/Gil-Werman: префиксы g и суффиксы s внутри блоков длины k, три сравнения на элемент.
+    template <typename T, typename Op>
+    static void running_extremum_1d(const T* row, int off, int lo, int hi, int n, int k, T* g, T* s, T* out, Op op) {
+        const int ext = n + k - 1;
+        const T neutral = Op::neutral();
+
+        if (off >= lo && off + ext <= hi) {
+            std::memcpy(s, row + off, sizeof(T) * ext);
+        }
+        else {
+            for (int t = 0; t < ext; ++t) {
+                int x = t + off;
+                s[t] = (x >= lo && x < hi) ? row[x] : neutral;
+            }
+        }
+
+        for (int b = 0; b < ext; b += k) {
+            const int e = std::min(b + k, ext);
+            g[b] = s[b];
+            for (int t = b + 1; t < e; ++t) {
+                g[t] = op(g[t - 1], s[t]);
+            }
+            for (int t = e - 2; t >= b; --t) {
+                s[t] = op(s[t], s[t + 1]);
+            }
+        }
+
+        for (int i = 0; i < n; ++i) {
+            out[i] = op(s[i], g[i + k - 1]);
+        }
+    }
+
+    // Экстремум по прямоугольнику w x h, сдвинутому на (ox, oy) относительно пикселя.
+    // Как и OpenCV, для ROI берёт соседей из родительской матрицы, за её пределами - нейтральное значение.
+    template <typename T, typename Op>
+    static void rect_extremum(const cv::Mat& src, cv::Mat& dst, int ox, int oy, int w, int h, Op op) {
+        cv::Size whole;
+        cv::Point ofs;
+        src.locateROI(whole, ofs);
+
+        const int rows = src.rows;
+        const int cols = src.cols;
+        const int col_lo = -ofs.x;
+        const int col_hi = whole.width - ofs.x;
+        const int row_lo = -ofs.y;
+        const int row_hi = whole.height - ofs.y;
+        const T neutral = Op::neutral();
+
+        const int hrows = rows + h - 1;
+        const int ext = std::max(cols + w - 1, hrows);
+        T* horiz = scratch<T>(static_cast<size_t>(hrows) * cols * 3 + static_cast<size_t>(ext) * 2);
+        T* g_rows = horiz + static_cast<size_t>(hrows) * cols;
+        T* s_rows = g_rows + static_cast<size_t>(hrows) * cols;
+        T* g = s_rows + static_cast<size_t>(hrows) * cols;
+        T* s = g + ext;
+
+        // Горизонтальный проход по всем строкам, которые попадут в вертикальное окно
+        for (int t = 0; t < hrows; ++t) {
+            const int sy = t + oy;
+            T* out = horiz + static_cast<size_t>(t) * cols;
+            if (sy < row_lo || sy >= row_hi) {
+                std::fill(out, out + cols, neutral);
+                continue;
+            }
+            const T* row = reinterpret_cast<const T*>(src.data + static_cast<ptrdiff_t>(sy) * static_cast<ptrdiff_t>(src.step[0]));
+            running_extremum_1d(row, ox, col_lo, col_hi, cols, w, g, s, out, op);
+        }
+
+        // Вертикальный проход тем же приёмом, но целыми строками - внутренние циклы векторизуются
+        dst.create(rows, cols, src.type());
+        for (int b = 0; b < hrows; b += h) {
+            const int e = std::min(b + h, hrows);
+            std::memcpy(g_rows + static_cast<size_t>(b) * cols, horiz + static_cast<size_t>(b) * cols, sizeof(T) * cols);
+            for (int t = b + 1; t < e; ++t) {
+                const T* prev = g_rows + static_cast<size_t>(t - 1) * cols;
+                const T* cur = horiz + static_cast<size_t>(t) * cols;
+                T* out = g_rows + static_cast<size_t>(t) * cols;
+                for (int x = 0; x < cols; ++x) {
+                    out[x] = op(prev[x], cur[x]);
+                }
+            }
+            std::memcpy(s_rows + static_cast<size_t>(e - 1) * cols, horiz + static_cast<size_t>(e - 1) * cols, sizeof(T) * cols);
+            for (int t = e - 2; t >= b; --t) {
+                const T* next = s_rows + static_cast<size_t>(t + 1) * cols;
+                const T* cur = horiz + static_cast<size_t>(t) * cols;
+                T* out = s_rows + static_cast<size_t>(t) * cols;
+                for (int x = 0; x < cols; ++x) {
+                    out[x] = op(cur[x], next[x]);
+                }
+            }
+        }
+        for (int y = 0; y < rows; ++y) {
+            const T* s_row = s_rows + static_cast<size_t>(y) * cols;
+            const T* g_row = g_rows + static_cast<size_t>(y + h - 1) * cols;
+            T* out = dst.ptr<T>(y);
+            for (int x = 0; x < cols; ++x) {
+                out[x] = op(s_row[x], g_row[x]);
+            }
+        }
+    }
+
+    template <typename T, typename Op>
+    static void union_extremum(const cv::Mat& src, cv::Mat& dst, const std::vector<cv::Rect>& rects, cv::Point anchor, Op op) {
+        cv::Mat part;
+        rect_extremum<T>(src, dst, rects[0].x - anchor.x, rects[0].y - anchor.y, rects[0].width, rects[0].height, op);
+        for (size_t i = 1; i < rects.size(); ++i) {
+            rect_extremum<T>(src, part, rects[i].x - anchor.x, rects[i].y - anchor.y, rects[i].width, rects[i].height, op);
+            for (int y = 0; y < dst.rows; ++y) {
+                T* out = dst.ptr<T>(y);
+                const T* p = part.ptr<T>(y);
+                for (int x = 0; x < dst.cols; ++x) {
+                    out[x] = op(out[x], p[x]);
+                }
+            }
+        }
+    }
+
+    static void extremum_dispatch(const cv::Mat& src, cv::Mat& dst, const std::vector<cv::Rect>& rects, cv::Point anchor, bool is_max) {
+        // Результат собирается во временной матрице, если dst делит память с src
+        cv::Mat result;
+        bool aliased = dst.data != nullptr && src.datastart < dst.dataend && dst.datastart < src.dataend;
+        cv::Mat& out = aliased ? result : dst;
+
+        switch (src.depth()) {
+        case CV_8U:
+            is_max ? union_extremum<uchar>(src, out, rects, anchor, MaxOp<uchar>()) : union_extremum<uchar>(src, out, rects, anchor, MinOp<uchar>());
+            break;
+        case CV_16U:
+            is_max ? union_extremum<ushort>(src, out, rects, anchor, MaxOp<ushort>()) : union_extremum<ushort>(src, out, rects, anchor, MinOp<ushort>());
+            break;
+        case CV_32F:
+            is_max ? union_extremum<float>(src, out, rects, anchor, MaxOp<float>()) : union_extremum<float>(src, out, rects, anchor, MinOp<float>());
+            break;
+        default:
+            CV_Error(cv::Error::StsUnsupportedFormat, "semcv morphology: unsupported depth");
+        }
+
+        if (aliased) {
+            result.copyTo(dst);
+        }
+    }
+
+    std::vector<cv::Rect> decompose_structuring_element(const cv::Mat& kernel) {
+        CV_Assert(kernel.type() == CV_8UC1);
+
+        // Отрезок единиц в каждой строке; строки с разрывами не раскладываются
+        std::vector<std::pair<int, int>> spans(kernel.rows, std::make_pair(-1, -1));
+        for (int y = 0; y < kernel.rows; ++y) {
+            const uchar* row = kernel.ptr<uchar>(y);
+            int first = -1;
+            int last = -1;
+            int ones = 0;
+            for (int x = 0; x < kernel.cols; ++x) {
+                if (row[x]) {
+                    if (first < 0) first = x;
+                    last = x;
+                    ++ones;
+                }
+            }
+            if (ones > 0 && ones != last - first + 1) {
+                return {};
+            }
+            spans[y] = std::make_pair(first, last);
+        }
+
+        // Для каждого различного отрезка - прямоугольник из подряд идущих строк, чьи отрезки его содержат
+        std::vector<cv::Rect> rects;
+        for (int y = 0; y < kernel.rows; ++y) {
+            const int x0 = spans[y].first;
+            const int x1 = spans[y].second;
+            if (x0 < 0) continue;
+            int top = y;
+            while (top > 0 && spans[top - 1].first >= 0 && spans[top - 1].first <= x0 && spans[top - 1].second >= x1) --top;
+            int bottom = y;
+            while (bottom + 1 < kernel.rows && spans[bottom + 1].first >= 0 && spans[bottom + 1].first <= x0 && spans[bottom + 1].second >= x1) ++bottom;
+            cv::Rect rect(x0, top, x1 - x0 + 1, bottom - top + 1);
+            bool duplicate = false;
+            for (const auto& r : rects) {
+                if (r.x == rect.x && r.y == rect.y && r.width == rect.width && r.height == rect.height) {
+                    duplicate = true;
+                    break;
+                }
+            }
+            if (!duplicate) {
+                rects.push_back(rect);
+            }
+        }
+        return rects;
+    }
+
+    static bool fast_path_supported(const cv::Mat& src) {
+        int depth = src.depth();
+        return src.channels() == 1 && (depth == CV_8U || depth == CV_16U || depth == CV_32F) && !src.empty();
+    }
+
+    void erode_rect(const cv::Mat& src, cv::Mat& dst, cv::Size ksize) {
+        CV_Assert(fast_path_supported(src) && ksize.width > 0 && ksize.height > 0);
+        std::vector<cv::Rect> rects = { cv::Rect(0, 0, ksize.width, ksize.height) };
+        extremum_dispatch(src, dst, rects, cv::Point(ksize.width / 2, ksize.height / 2), false);
+    }
+
+    void dilate_rect(const cv::Mat& src, cv::Mat& dst, cv::Size ksize) {
+        CV_Assert(fast_path_supported(src) && ksize.width > 0 && ksize.height > 0);
+        std::vector<cv::Rect> rects = { cv::Rect(0, 0, ksize.width, ksize.height) };
+        extremum_dispatch(src, dst, rects, cv::Point(ksize.width / 2, ksize.height / 2), true);
+    }
+
+    void morphology_ex(const cv::Mat& src, cv::Mat& dst, int op, const cv::Mat& kernel, cv::Point anchor) {
+        cv::Mat element = kernel.empty() ? cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3)) : kernel;
+        if (anchor.x < 0) anchor.x = element.cols / 2;
+        if (anchor.y < 0) anchor.y = element.rows / 2;
+
+        std::vector<cv::Rect> rects;
+        if (fast_path_supported(src) && element.type() == CV_8UC1) {
+            rects = decompose_structuring_element(element);
+        }
+        bool supported_op = op == cv::MORPH_ERODE || op == cv::MORPH_DILATE || op == cv::MORPH_OPEN || op == cv::MORPH_CLOSE;
+        if (rects.empty() || !supported_op) {
+            cv::morphologyEx(src, dst, op, element, anchor);
+            return;
+        }
+
+        switch (op) {
+        case cv::MORPH_ERODE:
+            extremum_dispatch(src, dst, rects, anchor, false);
+            break;
+        case cv::MORPH_DILATE:
+            extremum_dispatch(src, dst, rects, anchor, true);
+            break;
+        case cv::MORPH_OPEN: {
+            cv::Mat tmp;
+            extremum_dispatch(src, tmp, rects, anchor, false);
+            extremum_dispatch(tmp, dst, rects, anchor, true);
+            break;
+        }
+        case cv::MORPH_CLOSE: {
+            cv::Mat tmp;
+            extremum_dispatch(src, tmp, rects, anchor, true);
+            extremum_dispatch(tmp, dst, rects, anchor, false);
+            break;
+        }
+        }
+    }
+
+} // namespace semcv
@@ -0,0 +1,83 @@
+#include "semcv.hpp"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace semcv {
+
+    // Минимум элементов на блок строк для cv::parallel_for_
+    static const size_t NOISE_MIN_BLOCK_ELEMENTS = 1 << 14;
+
+    // Финализатор SplitMix64: биекция на 64-битных числах, так что разные счётчики дают разные выходы
+    static inline uint64_t splitmix64(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // Строка y: пары нормальных отсчётов по Боксу-Мюллеру из счётчика (seed, y, номер пары).
+    // Равномерные величины считаются скалярно (хеш дешёвый), log, sqrt, sin и cos - векторизованными
+    // cv::log, cv::sqrt и cv::polarToCart над буферами строки.
+    static void gaussian_row(uint64_t seed, int y, int count, double stddev,
+                             std::vector<float>& radius, std::vector<float>& angle,
+                             std::vector<float>& z0, std::vector<float>& z1) {
+        const int pairs = (count + 1) / 2;
+        radius.resize(pairs);
+        angle.resize(pairs);
+        z0.resize(pairs);
+        z1.resize(pairs);
+        const uint64_t base = splitmix64(seed ^ (static_cast<uint64_t>(y) * 0x9E3779B97F4A7C15ULL));
+        const float unit = 1.0f / 16777216.0f; // 2^-24
+        const float two_pi = static_cast<float>(2.0 * CV_PI);
+        for (int k = 0; k < pairs; ++k) {
+            uint64_t bits = splitmix64(base + static_cast<uint64_t>(k) * 0x9E3779B97F4A7C15ULL);
+            radius[k] = static_cast<float>((bits >> 40) + 1) * unit;              // (0, 1]
+            angle[k] = static_cast<float>((bits >> 8) & 0xFFFFFF) * unit * two_pi; // [0, 2pi)
+        }
+        cv::Mat r(1, pairs, CV_32F, radius.data());
+        cv::Mat a(1, pairs, CV_32F, angle.data());
+        // r = stddev * sqrt(-2 ln u1)
+        cv::log(r, r);
+        r.convertTo(r, CV_32F, -2.0 * stddev * stddev);
+        cv::sqrt(r, r);
+        cv::Mat x(1, pairs, CV_32F, z0.data());
+        cv::Mat sn(1, pairs, CV_32F, z1.data());
+        cv::polarToCart(r, a, x, sn);
+    }
+
+    void add_noise_gau(const cv::Mat& src, cv::Mat& dst, double stddev, uint64_t seed) {
+        CV_Assert(src.depth() == CV_8U);
+        dst.create(src.size(), src.type());
+
+        const int count = src.cols * src.channels();
+        size_t row_elements = std::max<size_t>(count, 1);
+        int min_rows = static_cast<int>(std::max<size_t>(1, NOISE_MIN_BLOCK_ELEMENTS / row_elements));
+        int blocks = std::max(1, std::min(cv::getNumThreads(), (src.rows + min_rows - 1) / min_rows));
+
+        // Отсчёты строки зависят только от (seed, y), поэтому результат не зависит от числа потоков и блоков
+        cv::parallel_for_(cv::Range(0, blocks), [&](const cv::Range& range) {
+            std::vector<float> radius, angle, z0, z1;
+            for (int b = range.start; b < range.end; ++b) {
+                int row_begin = static_cast<int>(static_cast<int64_t>(src.rows) * b / blocks);
+                int row_end = static_cast<int>(static_cast<int64_t>(src.rows) * (b + 1) / blocks);
+                for (int y = row_begin; y < row_end; ++y) {
+                    gaussian_row(seed, y, count, stddev, radius, angle, z0, z1);
+                    const uchar* s = src.ptr<uchar>(y);
+                    uchar* d = dst.ptr<uchar>(y);
+                    for (int x = 0; x < count; ++x) {
+                        float noise = (x & 1) ? z1[x >> 1] : z0[x >> 1];
+                        d[x] = cv::saturate_cast<uchar>(s[x] + noise);
+                    }
+                }
+            }
+        });
+    }
+
+    cv::Mat add_noise_gau(const cv::Mat& img, double stddev, uint64_t seed) {
+        cv::Mat noisy_img;
+        add_noise_gau(img, noisy_img, stddev, seed);
+        return noisy_img;
+    }
+
+} // namespace semcv
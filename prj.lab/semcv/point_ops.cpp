@@ -0,0 +1,127 @@
+#include "semcv.hpp"
+#include "lut_cache.hpp"
+#include <opencv2/opencv.hpp>
+#include <cmath>
+
+namespace semcv {
+
+    // Таблица на 256 байт строится за микросекунды, кеш нужен только для повторов одной гаммы
+    static const size_t GAMMA_LUT_CACHE_SIZE = 16;
+
+    cv::Mat gamma_lut(double gamma) {
+        static LutCache<cv::Mat> cache(GAMMA_LUT_CACHE_SIZE);
+
+        auto table = cache.get(gamma, [](double g) {
+            cv::Mat lookUpTable(1, 256, CV_8U);
+            uchar* p = lookUpTable.ptr();
+            for (int i = 0; i < 256; ++i) {
+                p[i] = cv::saturate_cast<uchar>(pow(i / 255.0, g) * 255.0);
+            }
+            return lookUpTable;
+        });
+        // Копия: кешированная таблица общая для всех потоков, и её нельзя отдавать на запись
+        return table->clone();
+    }
+
+    static bool is_identity(const cv::Mat& table) {
+        const uchar* p = table.ptr();
+        for (int i = 0; i < 256; ++i) {
+            if (p[i] != i) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    PointOps::PointOps(const Histogram& hist, int channel) {
+        CV_Assert(channel >= 0 && channel < hist.channels());
+        counts_.assign(hist.counts(channel), hist.counts(channel) + Histogram::BINS);
+    }
+
+    PointOps& PointOps::lut(const cv::Mat& table) {
+        CV_Assert(table.type() == CV_8UC1 && table.total() == 256 && table.isContinuous());
+        // Своя копия: вызывающий может изменить таблицу до apply()
+        steps_.push_back({ Step::LUT, table.clone(), 0.0, 0.0 });
+        return *this;
+    }
+
+    PointOps& PointOps::gamma(double gamma) {
+        steps_.push_back({ Step::GAMMA, cv::Mat(), gamma, 0.0 });
+        return *this;
+    }
+
+    PointOps& PointOps::autocontrast(double q_black, double q_white) {
+        CV_Assert(!counts_.empty());
+        steps_.push_back({ Step::AUTOCONTRAST, cv::Mat(), q_black, q_white });
+        return *this;
+    }
+
+    PointOps& PointOps::then(const PointOps& next) {
+        for (const Step& step : next.steps_) {
+            CV_Assert(step.kind != Step::AUTOCONTRAST || !counts_.empty());
+        }
+        steps_.insert(steps_.end(), next.steps_.begin(), next.steps_.end());
+        return *this;
+    }
+
+    // Композиция по порядку записи: composed <- t(composed). Гистограмма значений переносится
+    // через каждую таблицу, autocontrast берёт пороги по уже преобразованному распределению.
+    cv::Mat PointOps::table() const {
+        cv::Mat composed(1, 256, CV_8U);
+        uchar* c = composed.ptr();
+        for (int i = 0; i < 256; ++i) {
+            c[i] = static_cast<uchar>(i);
+        }
+        std::vector<uint64_t> counts = counts_;
+        std::vector<uint64_t> mapped;
+        for (const Step& step : steps_) {
+            cv::Mat table;
+            switch (step.kind) {
+            case Step::LUT:
+                table = step.table;
+                break;
+            case Step::GAMMA:
+                table = gamma_lut(step.a);
+                break;
+            case Step::AUTOCONTRAST:
+                table = autocontrast_lut(CDF(counts.data()), step.a, step.b);
+                break;
+            }
+            const uchar* t = table.ptr();
+            for (int i = 0; i < 256; ++i) {
+                c[i] = t[c[i]];
+            }
+            if (!counts.empty()) {
+                mapped.assign(Histogram::BINS, 0);
+                for (int v = 0; v < Histogram::BINS; ++v) {
+                    mapped[t[v]] += counts[v];
+                }
+                counts.swap(mapped);
+            }
+        }
+        return composed;
+    }
+
+    bool PointOps::identity() const {
+        return steps_.empty() || is_identity(table());
+    }
+
+    void PointOps::apply(const cv::Mat& img, cv::Mat& dst) const {
+        CV_Assert(img.depth() == CV_8U);
+        cv::Mat composed = table();
+        if (is_identity(composed)) {
+            if (dst.data != img.data) {
+                img.copyTo(dst);
+            }
+            return;
+        }
+        cv::LUT(img, composed, dst);
+    }
+
+    cv::Mat PointOps::apply(const cv::Mat& img) const {
+        cv::Mat dst;
+        apply(img, dst);
+        return dst;
+    }
+
+} // namespace semcv
@@ -0,0 +1,94 @@
+#include "semcv.hpp"
+#include "bench_util.hpp"
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <string>
+
+// semcv::PointOps (одна таблица, один проход) против тех же операций по очереди, с проверкой,
+// что результаты совпадают побитно.
+// Usage: semcv_point_ops_bench [image] [iterations]
+
+bool same(const cv::Mat& a, const cv::Mat& b) {
+    return a.size() == b.size() && a.type() == b.type() && cv::norm(a, b, cv::NORM_INF) == 0.0;
+}
+
+cv::Mat invert_lut() {
+    cv::Mat table(1, 256, CV_8U);
+    uchar* p = table.ptr();
+    for (int i = 0; i < 256; ++i) {
+        p[i] = static_cast<uchar>(255 - i);
+    }
+    return table;
+}
+
+// gamma -> autocontrast -> инверсия -> gamma -> autocontrast; autocontrast только для CV_8UC1
+void bench_gray(const std::string& name, const cv::Mat& img, int iterations) {
+    const cv::Mat invert = invert_lut();
+    cv::Mat sequential;
+    double sequential_ms = time_ms(iterations, [&]() {
+        cv::Mat tmp = semcv::gamma_correction(img, 0.8);
+        tmp = semcv::autocontrast(tmp, 0.02, 0.98);
+        cv::LUT(tmp, invert, tmp);
+        tmp = semcv::gamma_correction(tmp, 1.5);
+        sequential = semcv::autocontrast(tmp, 0.1, 0.9);
+    });
+
+    cv::Mat chained;
+    double chained_ms = time_ms(iterations, [&]() {
+        semcv::PointOps ops{ semcv::Histogram(img) };
+        ops.gamma(0.8).autocontrast(0.02, 0.98).lut(invert).gamma(1.5).autocontrast(0.1, 0.9);
+        chained = ops.apply(img);
+    });
+
+    std::cout << name << " " << img.cols << "x" << img.rows << "x" << img.channels()
+              << ": sequential " << sequential_ms << " ms, PointOps " << chained_ms << " ms"
+              << ", speedup " << sequential_ms / chained_ms
+              << (same(sequential, chained) ? ", results equal" : ", RESULTS DIFFER") << std::endl;
+}
+
+// Гаммы и инверсия для многоканального изображения: гистограмма не нужна
+void bench_bgr(const std::string& name, const cv::Mat& img, int iterations) {
+    const cv::Mat invert = invert_lut();
+    cv::Mat sequential;
+    double sequential_ms = time_ms(iterations, [&]() {
+        cv::Mat tmp = semcv::gamma_correction(img, 2.2);
+        cv::LUT(tmp, invert, tmp);
+        sequential = semcv::gamma_correction(tmp, 0.45);
+    });
+
+    cv::Mat chained;
+    double chained_ms = time_ms(iterations, [&]() {
+        chained = semcv::PointOps().gamma(2.2).lut(invert).gamma(0.45).apply(img);
+    });
+
+    std::cout << name << " " << img.cols << "x" << img.rows << "x" << img.channels()
+              << ": sequential " << sequential_ms << " ms, PointOps " << chained_ms << " ms"
+              << ", speedup " << sequential_ms / chained_ms
+              << (same(sequential, chained) ? ", results equal" : ", RESULTS DIFFER") << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 2 ? std::stoi(argv[2]) : 50;
+
+    cv::Mat bgr;
+    if (argc > 1) {
+        bgr = cv::imread(argv[1], cv::IMREAD_COLOR);
+        if (bgr.empty()) {
+            std::cerr << "Failed to load image: " << argv[1] << std::endl;
+            return 1;
+        }
+    } else {
+        bgr = cv::Mat(3000, 2000, CV_8UC3);
+        cv::randn(bgr, cv::Scalar::all(128), cv::Scalar::all(40));
+    }
+    cv::Mat gray;
+    cv::cvtColor(bgr, gray, cv::COLOR_BGR2GRAY);
+    cv::Mat random(bgr.size(), CV_8UC1);
+    cv::randu(random, cv::Scalar(0), cv::Scalar(256));
+
+    std::cout << "OpenCV threads: " << cv::getNumThreads() << ", iterations: " << iterations << std::endl;
+    bench_gray("gray", gray, iterations);
+    bench_gray("uniform noise", random, iterations);
+    bench_bgr("bgr", bgr, iterations);
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include "semcv.hpp"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace semcv {
+
+    // Минимум пикселей на блок строк для cv::parallel_for_
+    static const size_t REGION_MIN_BLOCK_PIXELS = 1 << 15;
+
+    // Накопитель области в пределах блока: целые суммы складываются без потери точности
+    struct RegionAccumulator {
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t sq_sum = 0;
+        int min = std::numeric_limits<int>::max();
+        int max = std::numeric_limits<int>::min();
+    };
+
+    template <typename T, typename L>
+    static void accumulate_regions(const cv::Mat& img, const cv::Mat& labels, int row_begin, int row_end,
+                                   int label_count, RegionAccumulator* acc) {
+        const unsigned n = static_cast<unsigned>(label_count);
+        for (int y = row_begin; y < row_end; ++y) {
+            const T* p = img.ptr<T>(y);
+            const L* l = labels.ptr<L>(y);
+            for (int x = 0; x < img.cols; ++x) {
+                // Отрицательные метки CV_32SC1 после приведения тоже больше n
+                unsigned label = static_cast<unsigned>(l[x]);
+                if (label >= n) {
+                    continue;
+                }
+                RegionAccumulator& a = acc[label];
+                const int v = p[x];
+                ++a.count;
+                a.sum += static_cast<uint64_t>(v);
+                a.sq_sum += static_cast<uint64_t>(v) * static_cast<uint64_t>(v);
+                a.min = std::min(a.min, v);
+                a.max = std::max(a.max, v);
+            }
+        }
+    }
+
+    template <typename T, typename L>
+    static std::vector<RegionStats> region_stats_blocks(const cv::Mat& img, const cv::Mat& labels, int label_count) {
+        int min_rows = static_cast<int>(std::max<size_t>(1, REGION_MIN_BLOCK_PIXELS / std::max(img.cols, 1)));
+        int blocks = std::max(1, std::min(cv::getNumThreads(), (img.rows + min_rows - 1) / min_rows));
+
+        std::vector<RegionAccumulator> partial(static_cast<size_t>(label_count) * blocks);
+        cv::parallel_for_(cv::Range(0, blocks), [&](const cv::Range& range) {
+            for (int b = range.start; b < range.end; ++b) {
+                int row_begin = static_cast<int>(static_cast<int64_t>(img.rows) * b / blocks);
+                int row_end = static_cast<int>(static_cast<int64_t>(img.rows) * (b + 1) / blocks);
+                accumulate_regions<T, L>(img, labels, row_begin, row_end, label_count,
+                                         partial.data() + static_cast<size_t>(label_count) * b);
+            }
+        });
+
+        // Сведение блоков по порядку; суммы целые, поэтому результат точный при любом разбиении
+        std::vector<RegionStats> stats(label_count);
+        for (int r = 0; r < label_count; ++r) {
+            RegionAccumulator total;
+            for (int b = 0; b < blocks; ++b) {
+                const RegionAccumulator& a = partial[static_cast<size_t>(label_count) * b + r];
+                total.count += a.count;
+                total.sum += a.sum;
+                total.sq_sum += a.sq_sum;
+                total.min = std::min(total.min, a.min);
+                total.max = std::max(total.max, a.max);
+            }
+            if (total.count == 0) {
+                continue;
+            }
+            RegionStats& s = stats[r];
+            s.count = total.count;
+            s.mean = static_cast<double>(total.sum) / total.count;
+            double variance = static_cast<double>(total.sq_sum) / total.count - s.mean * s.mean;
+            s.stddev = std::sqrt(std::max(variance, 0.0));
+            s.min = total.min;
+            s.max = total.max;
+        }
+        return stats;
+    }
+
+    template <typename T>
+    static std::vector<RegionStats> region_stats_depth(const cv::Mat& img, const cv::Mat& labels, int label_count) {
+        if (labels.type() == CV_8UC1) {
+            return region_stats_blocks<T, uchar>(img, labels, label_count);
+        }
+        return region_stats_blocks<T, int>(img, labels, label_count);
+    }
+
+    std::vector<RegionStats> region_stats(const cv::Mat& img, const cv::Mat& labels, int label_count) {
+        CV_Assert(img.type() == CV_8UC1 || img.type() == CV_16UC1);
+        CV_Assert((labels.type() == CV_8UC1 || labels.type() == CV_32SC1) && labels.size() == img.size());
+        CV_Assert(label_count > 0);
+
+        if (img.empty()) {
+            return std::vector<RegionStats>(label_count);
+        }
+        if (img.depth() == CV_8U) {
+            return region_stats_depth<uchar>(img, labels, label_count);
+        }
+        return region_stats_depth<ushort>(img, labels, label_count);
+    }
+
+    RegionStats merge_region_stats(const RegionStats& a, const RegionStats& b) {
+        if (a.count == 0) {
+            return b;
+        }
+        if (b.count == 0) {
+            return a;
+        }
+        const double na = static_cast<double>(a.count);
+        const double nb = static_cast<double>(b.count);
+        const double n = na + nb;
+        const double delta = b.mean - a.mean;
+        // Суммы квадратов отклонений от своих средних складываются с поправкой на разницу средних
+        const double m2 = a.stddev * a.stddev * na + b.stddev * b.stddev * nb + delta * delta * na * nb / n;
+
+        RegionStats merged;
+        merged.count = a.count + b.count;
+        merged.mean = a.mean + delta * nb / n;
+        merged.stddev = std::sqrt(std::max(m2 / n, 0.0));
+        merged.min = std::min(a.min, b.min);
+        merged.max = std::max(a.max, b.max);
+        return merged;
+    }
+
+} // namespace semcv
@@ -46,13 +46,11 @@ namespace semcv {
     }
 
     cv::Mat gamma_correction(const cv::Mat& img, double gamma) {
-        cv::Mat lookUpTable(1, 256, CV_8U);
-        uchar* p = lookUpTable.ptr();
-        for (int i = 0; i < 256; ++i) {
-            p[i] = cv::saturate_cast<uchar>(pow(i / 255.0, gamma) * 255.0);
+        if (img.depth() == CV_16U || img.depth() == CV_32F) {
+            return gamma_correction_deep(img, gamma);
         }
         cv::Mat res;
-        cv::LUT(img, lookUpTable, res);
+        cv::LUT(img, gamma_lut(gamma), res);
         return res;
     }
 
@@ -72,19 +70,15 @@ namespace semcv {
     }
 
     cv::Mat add_noise_gau(const cv::Mat& img, const int std) {
-        cv::Mat noise(img.size(), CV_16SC1);
-        cv::randn(noise, cv::Scalar(0), cv::Scalar(std));
-        cv::Mat noisy_img;
-        cv::add(img, noise, noisy_img, cv::noArray(), CV_8UC1);
-        return noisy_img;
+        // Зерно берётся из глобального генератора OpenCV: cv::setRNGSeed по-прежнему делает шум воспроизводимым
+        cv::RNG& rng = cv::theRNG();
+        uint64_t seed = (static_cast<uint64_t>(rng.next()) << 32) | rng.next();
+        return add_noise_gau(img, static_cast<double>(std), seed);
     }
 
     cv::Mat compute_histogram(const cv::Mat& img) {
-        int histSize = 256;
-        float range[] = { 0, 256 };
-        const float* histRange = { range };
-        cv::Mat hist;
-        cv::calcHist(&img, 1, 0, cv::Mat(), hist, 1, &histSize, &histRange);
+        int histSize = Histogram::BINS;
+        cv::Mat hist = Histogram(img).to_mat();
 
         int hist_h = 256;
         int hist_w = 256;
@@ -102,12 +96,9 @@ namespace semcv {
     }
 
     cv::Mat create_histogram(const cv::Mat& img) {
-        const int HIST_SIZE = 256;
-        const float RANGE[] = { 0, 256 };
-        const float* HIST_RANGE = { RANGE };
+        const int HIST_SIZE = Histogram::BINS;
 
-        cv::Mat hist;
-        cv::calcHist(&img, 1, 0, cv::Mat(), hist, 1, &HIST_SIZE, &HIST_RANGE);
+        cv::Mat hist = Histogram(img).to_mat();
 
         int hist_w = 512;
         int hist_h = 400;
@@ -128,6 +119,13 @@ namespace semcv {
     }
 
     void calculate_distribution_params(const cv::Mat& img, const cv::Mat& mask, double& mean, double& stddev) {
+        if (img.type() == CV_8UC1) {
+            CDF cdf(img, mask);
+            mean = cdf.mean();
+            stddev = cdf.stddev();
+            return;
+        }
+
         cv::Scalar mean_scalar, stddev_scalar;
         cv::meanStdDev(img, mean_scalar, stddev_scalar, mask);
 
@@ -135,37 +133,10 @@ namespace semcv {
         stddev = stddev_scalar[0];
     }
 
-    cv::Mat autocontrast(const cv::Mat& img, const double q_black, const double q_white) {
-        CV_Assert(img.type() == CV_8UC1); 
-
-        int histSize = 256;
-        float range[] = { 0, 256 };
-        const float* histRange = { range };
-        cv::Mat hist;
-        cv::calcHist(&img, 1, 0, cv::Mat(), hist, 1, &histSize, &histRange);
-
-        cv::normalize(hist, hist, 0, 1, cv::NORM_MINMAX, -1, cv::Mat());
-
-        double total_pixels = img.rows * img.cols;
-        double black_threshold = q_black * total_pixels;
-        double white_threshold = q_white * total_pixels;
+    cv::Mat autocontrast_lut(const CDF& cdf, const double q_black, const double q_white) {
+        int black_level = std::max(cdf.quantile(q_black), 0);
+        int white_level = std::max(cdf.quantile(q_white), 0);
 
-        int black_level = 0;
-        int white_level = 255;
-
-        double sum = 0;
-        for (int i = 0; i < histSize; ++i) {
-            sum += hist.at<float>(i) * total_pixels;
-            if (sum >= black_threshold && black_level == 0) {
-                black_level = i;
-            }
-            if (sum >= white_threshold) {
-                white_level = i;
-                break;
-            }
-        }
-
-        cv::Mat result;
         cv::Mat lut(1, 256, CV_8U);
         uchar* p = lut.ptr();
         for (int i = 0; i < 256; ++i) {
@@ -179,24 +150,46 @@ namespace semcv {
                 p[i] = cv::saturate_cast<uchar>(255.0 * (i - black_level) / (white_level - black_level));
             }
         }
+        return lut;
+    }
 
-        cv::LUT(img, lut, result);
+    cv::Mat autocontrast(const cv::Mat& img, const double q_black, const double q_white) {
+        if (img.type() == CV_16UC1 || img.type() == CV_32FC1) {
+            return autocontrast_deep(img, q_black, q_white);
+        }
+        CV_Assert(img.type() == CV_8UC1); 
+
+        return autocontrast(img, CDF(img), q_black, q_white);
+    }
+
+    cv::Mat autocontrast(const cv::Mat& img, const CDF& cdf, const double q_black, const double q_white) {
+        CV_Assert(img.type() == CV_8UC1); 
+
+        cv::Mat result;
+        cv::LUT(img, autocontrast_lut(cdf, q_black, q_white), result);
         return result;
     }
 
     cv::Mat autocontrast_rgb(const cv::Mat& img, const double q_black, const double q_white) {
-        CV_Assert(img.type() == CV_8UC3); 
+        cv::Mat result;
+        autocontrast_rgb(img, result, q_black, q_white);
+        return result;
+    }
 
-        std::vector<cv::Mat> channels;
-        cv::split(img, channels);
+    // Два прохода по чередующимся пикселям: гистограммы всех каналов (Histogram), затем трёхканальный
+    // LUT, у которого канал c - LUT канала c. Результат тот же, что у split + autocontrast по каналам + merge.
+    void autocontrast_rgb(const cv::Mat& img, cv::Mat& dst, const double q_black, const double q_white) {
+        CV_Assert(img.type() == CV_8UC3); 
 
-        for (int i = 0; i < 3; ++i) {
-            channels[i] = autocontrast(channels[i], q_black, q_white);
+        Histogram hist(img);
+        cv::Mat channel_luts[3];
+        for (int c = 0; c < 3; ++c) {
+            channel_luts[c] = autocontrast_lut(CDF(hist, c), q_black, q_white);
         }
 
-        cv::Mat result;
-        cv::merge(channels, result);
-        return result;
+        cv::Mat lut;
+        cv::merge(channel_luts, 3, lut);
+        cv::LUT(img, lut, dst);
     }
 
 } // namespace semcv
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define SEMCV_HPP
 
 #include <opencv2/opencv.hpp>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <filesystem>
@@ -11,15 +12,193 @@ namespace semcv {
     std::string strid_from_mat(const cv::Mat& img, const int n = 4);
     std::vector<std::filesystem::path> get_list_of_file_paths(const std::filesystem::path& path_lst);
     cv::Mat generate_striped_image();
+    // CV_8U - через LUT; CV_16U и CV_32F - через gamma_correction_deep
     cv::Mat gamma_correction(const cv::Mat& img, double gamma);
 
     cv::Mat gen_tgtimg00(const int lev0, const int lev1, const int lev2);
+    // Гауссов шум с насыщением за один проход без промежуточного изображения шума (CV_8U, любое число каналов).
+    // Отсчёты - Бокс-Мюллер от счётчика (seed, строка, номер пары), так что при одном seed результат
+    // одинаков при любом числе потоков. Вариант без seed берёт его из cv::theRNG().
+    // Отсчёты не те, что давал прежний cv::randn в CV_16SC1 + cv::add: распределение то же, но конкретный
+    // шум другой, поэтому шумные строки коллажа лабораторной 2 и их строки в CSV со статистикой изменились
+    // (порядок строк и формат прежние).
     cv::Mat add_noise_gau(const cv::Mat& img, const int std);
+    cv::Mat add_noise_gau(const cv::Mat& img, double stddev, uint64_t seed);
+    // dst может совпадать с src
+    void add_noise_gau(const cv::Mat& src, cv::Mat& dst, double stddev, uint64_t seed);
     cv::Mat create_histogram(const cv::Mat& img);
     void calculate_distribution_params(const cv::Mat& img, const cv::Mat& mask, double& mean, double& stddev);
 
+    // Статистика по областям карты меток за один проход вместо прохода с маской на каждую область.
+    // img - CV_8UC1 или CV_16UC1, labels - CV_8UC1 или CV_32SC1 того же размера; метки вне
+    // [0, label_count) пропускаются. Суммы целые, блоки строк сводятся по порядку, так что результат
+    // не зависит от числа потоков. Для пустой области count = 0, остальные поля нулевые.
+    struct RegionStats {
+        uint64_t count = 0;
+        double mean = 0.0;
+        double stddev = 0.0;
+        int min = 0;
+        int max = 0;
+    };
+    std::vector<RegionStats> region_stats(const cv::Mat& img, const cv::Mat& labels, int label_count);
+
+    // Статистика объединения двух непересекающихся областей без повторного прохода
+    // (дисперсия - по формуле Чана); так считаются вложенные области, которым не хватает одной метки.
+    RegionStats merge_region_stats(const RegionStats& a, const RegionStats& b);
+
+    // Гистограмма 8-битного изображения (CV_8UC1..CV_8UC4), все каналы за один проход без cv::split.
+    // Счёт в целых по чередующимся подгистограммам; строки делятся на блоки для cv::parallel_for_,
+    // блоки затем складываются, так что результат не зависит от числа потоков.
+    class Histogram {
+    public:
+        static const int BINS = 256;
+
+        Histogram() = default;
+        // mask (CV_8UC1, как img по размеру) - считать только пиксели, где mask != 0
+        explicit Histogram(const cv::Mat& img, const cv::Mat& mask = cv::Mat());
+        void compute(const cv::Mat& img, const cv::Mat& mask = cv::Mat());
+
+        int channels() const { return channels_; }
+        uint64_t total() const { return total_; } // пикселей (под маской)
+        const uint64_t* counts(int channel = 0) const { return counts_.data() + channel * BINS; }
+        uint64_t count(int channel, int bin) const { return counts_[channel * BINS + bin]; }
+        // BINS x 1 CV_32F, то же, что cv::calcHist с диапазоном [0, 256)
+        cv::Mat to_mat(int channel = 0) const;
+
+    private:
+        int channels_ = 0;
+        uint64_t total_ = 0;
+        std::vector<uint64_t> counts_;
+    };
+
+    // Накопленная гистограмма одного канала: строится один раз, дальше ранг уровня - O(1),
+    // квантиль - двоичный поиск по 256 уровням. Перебор многих пар квантилей на одном
+    // изображении стоит одного прохода по пикселям.
+    class CDF {
+    public:
+        CDF() = default;
+        explicit CDF(const Histogram& hist, int channel = 0);
+        explicit CDF(const uint64_t* counts); // Histogram::BINS счётчиков
+        explicit CDF(const cv::Mat& img, const cv::Mat& mask = cv::Mat()); // одноканальное CV_8U
+
+        uint64_t total() const { return rank_[Histogram::BINS]; }
+        // Число пикселей с уровнем <= level и их доля
+        uint64_t rank(int level) const;
+        double fraction(int level) const;
+        // Наименьший уровень L, для которого доля пикселей <= L не меньше q (q в [0, 1]):
+        // quantile(0) - минимальный уровень на изображении, quantile(1) - максимальный, -1 - пусто
+        int quantile(double q) const;
+        double mean() const;
+        double stddev() const;
+
+    private:
+        uint64_t rank_[Histogram::BINS + 1] = {}; // rank_[v] - пикселей с уровнем < v
+        uint64_t sum_ = 0;
+        uint64_t sq_sum_ = 0;
+    };
+
+    // Уровни q_black и q_white (квантили CDF) растягиваются на 0 и 255. До CDF пороги искались по
+    // гистограмме, нормированной NORM_MINMAX (то есть зависели от высоты самого большого столбца),
+    // так что на тех же q результат отличается; лабораторная 3 прежних правил не использовала
+    // и на это не опирается.
     cv::Mat autocontrast(const cv::Mat& img, const double q_black, const double q_white);
+    // Для перебора квантилей: cdf = CDF(img) строится один раз
+    cv::Mat autocontrast(const cv::Mat& img, const CDF& cdf, const double q_black, const double q_white);
+    cv::Mat autocontrast_lut(const CDF& cdf, const double q_black, const double q_white);
     cv::Mat autocontrast_rgb(const cv::Mat& img, const double q_black, const double q_white);
+    // dst может совпадать с img (обработка на месте)
+    void autocontrast_rgb(const cv::Mat& img, cv::Mat& dst, const double q_black, const double q_white);
+
+    // Глубокие форматы, параллельно по блокам строк. Номинальный диапазон: 0..65535 для CV_16U
+    // (гамма - LUT на 65536 уровней из кеша, автоконтраст - гистограмма на 65536 уровней) и 0..1 для CV_32F
+    // (гамма - cv::pow, значения меньше 0 считаются 0; автоконтраст - 65536 корзин между минимумом
+    // и максимумом кадра с интерполяцией внутри корзины, результат в [0, 1]).
+    // gamma_correction: любое число каналов; autocontrast: CV_16UC1 и CV_32FC1, его q как у 8-битного.
+    cv::Mat gamma_correction_deep(const cv::Mat& img, double gamma);
+    cv::Mat autocontrast_deep(const cv::Mat& img, double q_black, double q_white);
+
+    // LUT гаммы (1 x 256 CV_8U), кешируется по значению gamma (последние 16 значений);
+    // возвращается копия, её можно изменять
+    cv::Mat gamma_lut(double gamma);
+
+    // Отложенная цепочка поточечных 8-битных операций. Операции только записываются; apply()
+    // композирует их LUT в одну таблицу на 256 значений (LUT после LUT - тоже LUT) и проходит
+    // по пикселям один раз. Если цепочка построена по гистограмме исходного изображения,
+    // гистограмма переносится через каждую операцию, и autocontrast() в середине цепочки видит
+    // распределение уже преобразованных значений - результат побитно тот же, что у операций по очереди.
+    class PointOps {
+    public:
+        PointOps() = default;
+        explicit PointOps(const Histogram& hist, int channel = 0);
+
+        PointOps& lut(const cv::Mat& table); // 1 x 256 CV_8U
+        PointOps& gamma(double gamma);
+        PointOps& autocontrast(double q_black, double q_white); // нужна гистограмма
+        PointOps& then(const PointOps& next);
+
+        bool identity() const;
+        // Композиция всех операций, 1 x 256 CV_8U
+        cv::Mat table() const;
+        // Для img любого числа каналов CV_8U; dst может совпадать с img
+        void apply(const cv::Mat& img, cv::Mat& dst) const;
+        cv::Mat apply(const cv::Mat& img) const;
+
+    private:
+        struct Step {
+            enum Kind { LUT, GAMMA, AUTOCONTRAST } kind;
+            cv::Mat table; // для LUT
+            double a;      // gamma или q_black
+            double b;      // q_white
+        };
+        std::vector<Step> steps_;
+        std::vector<uint64_t> counts_; // гистограмма исходного изображения, пусто - не отслеживается
+    };
+
+    // Морфология с прямоугольными элементами (van Herk/Gil-Werman): бегущие min/max по строкам и столбцам,
+    // O(1) сравнений на пиксель при любом размере ядра. Поддерживаются одноканальные CV_8U, CV_16U, CV_32F;
+    // граница как у cv::morphologyEx по умолчанию, для ROI используются пиксели родительской матрицы.
+    void erode_rect(const cv::Mat& src, cv::Mat& dst, cv::Size ksize);
+    void dilate_rect(const cv::Mat& src, cv::Mat& dst, cv::Size ksize);
+    // Элемент из cv::getStructuringElement раскладывается на объединение прямоугольников
+    // (MORPH_ELLIPSE 5x5 - два прямоугольника). Если разложить нельзя - обычный cv::morphologyEx.
+    void morphology_ex(const cv::Mat& src, cv::Mat& dst, int op, const cv::Mat& kernel, cv::Point anchor = cv::Point(-1, -1));
+    std::vector<cv::Rect> decompose_structuring_element(const cv::Mat& kernel);
+
+    // Чтение изображений через mmap: cv::imdecode декодирует прямо из отображения файла
+    // (заголовок Mat без своей памяти), без промежуточного буфера, как у cv::imread.
+    // Без mmap (не POSIX) файл читается в собственный буфер.
+    enum class ReadAdvice { Normal, Sequential, WillNeed };
+
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        explicit MappedFile(const std::filesystem::path& path, ReadAdvice advice = ReadAdvice::Sequential);
+        ~MappedFile();
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool is_open() const { return data_ != nullptr; }
+        const uchar* data() const { return data_; }
+        size_t size() const { return size_; }
+        // Заголовок 1 x size() CV_8UC1 поверх отображения, действителен, пока открыт файл
+        cv::Mat mat() const;
+        // drop_cache - выбросить страницы файла из page cache (posix_fadvise, где он есть),
+        // чтобы однократно прочитанный пакет не вытеснял из кеша всё остальное
+        void close(bool drop_cache = false);
+
+    private:
+        const uchar* data_ = nullptr;
+        size_t size_ = 0;
+        int fd_ = -1;
+        bool mapped_ = false;
+        std::vector<uchar> fallback_;
+    };
+
+    cv::Mat imread_mapped(const std::filesystem::path& path, int flags = cv::IMREAD_COLOR, bool drop_cache = false);
+    // Подсказка ОС начать читать файл заранее, например следующий по порядку каталога
+    void prefetch_file(const std::filesystem::path& path);
 
 } // namespace semcv
 